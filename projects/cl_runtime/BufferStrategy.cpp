@@ -0,0 +1,254 @@
+#include "BufferStrategy.hpp"
+
+#include <iostream>
+
+static const BufferMode ALL_MODES[] =
+{
+    BufferMode::DeviceCopy,
+    BufferMode::UseHostPtr,
+    BufferMode::AllocHostPtr,
+    BufferMode::SvmCoarse,
+    BufferMode::SvmFine
+};
+
+const char* to_string(BufferMode mode)
+{
+    switch (mode)
+    {
+        case BufferMode::DeviceCopy:   return "device-copy";
+        case BufferMode::UseHostPtr:   return "use-host-ptr";
+        case BufferMode::AllocHostPtr: return "alloc-host-ptr";
+        case BufferMode::SvmCoarse:    return "svm-coarse";
+        default:                       return "svm-fine";
+    }
+}
+
+bool parse_buffer_mode(const std::string& name, BufferMode& mode)
+{
+    for (BufferMode candidate : ALL_MODES)
+    {
+        if (name == to_string(candidate))
+        {
+            mode = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool supports(const ClRuntime& runtime, BufferMode mode)
+{
+    switch (mode)
+    {
+        case BufferMode::SvmCoarse: return runtime.has_svm(CL_DEVICE_SVM_COARSE_GRAIN_BUFFER);
+        case BufferMode::SvmFine:   return runtime.has_svm(CL_DEVICE_SVM_FINE_GRAIN_BUFFER);
+        default:                    return true;
+    }
+}
+
+std::vector<BufferMode> supported_buffer_modes(const ClRuntime& runtime)
+{
+    std::vector<BufferMode> modes;
+
+    for (BufferMode mode : ALL_MODES)
+    {
+        if (supports(runtime, mode))
+        {
+            modes.push_back(mode);
+        }
+    }
+
+    return modes;
+}
+
+SharedBuffer::SharedBuffer(ClRuntime& runtime, BufferMode mode, std::size_t bytes)
+: m_context(runtime.context()),
+  m_queue(runtime.queue()),
+  m_mode(mode),
+  m_bytes(bytes),
+  m_svm(nullptr),
+  m_host(nullptr),
+  m_on_host(true)
+{
+    if (!supports(runtime, mode))
+    {
+        throw ClRuntimeError(std::string("Buffer mode not supported by the device: ") + to_string(mode));
+    }
+
+    const cl_map_flags map_flags = CL_MAP_READ | CL_MAP_WRITE;
+
+    switch (m_mode)
+    {
+        case BufferMode::DeviceCopy:
+            m_host_array = HostArray<unsigned char>(bytes);
+            m_buffer     = cl::Buffer(m_context, CL_MEM_READ_WRITE, bytes);
+            m_host       = m_host_array.data();
+            break;
+
+        case BufferMode::UseHostPtr:
+            // page-aligned, which also covers the 256-byte alignment some
+            // runtimes need to use the host array without a shadow copy
+            m_host_array = HostArray<unsigned char>(bytes);
+            m_buffer     = cl::Buffer(m_context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, bytes, m_host_array.data());
+            m_host       = m_queue.enqueueMapBuffer(m_buffer, CL_TRUE, map_flags, 0, bytes);
+            break;
+
+        case BufferMode::AllocHostPtr:
+            m_buffer = cl::Buffer(m_context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes);
+            m_host   = m_queue.enqueueMapBuffer(m_buffer, CL_TRUE, map_flags, 0, bytes);
+            break;
+
+        case BufferMode::SvmCoarse:
+        case BufferMode::SvmFine:
+        {
+            const cl_svm_mem_flags flags = m_mode == BufferMode::SvmFine
+                                         ? CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER
+                                         : CL_MEM_READ_WRITE;
+
+            m_svm = clSVMAlloc(m_context(), flags, bytes, 0);
+
+            if (m_svm == nullptr)
+            {
+                throw ClRuntimeError("clSVMAlloc() failed");
+            }
+
+            if (m_mode == BufferMode::SvmCoarse)
+            {
+                m_queue.enqueueMapSVM(m_svm, CL_TRUE, map_flags, bytes);
+            }
+
+            m_host = m_svm;
+            break;
+        }
+    }
+}
+
+SharedBuffer::~SharedBuffer()
+{
+    try
+    {
+        // a mapped buffer is unmapped before it is released
+        if (m_on_host && m_mode != BufferMode::DeviceCopy && m_mode != BufferMode::SvmFine)
+        {
+            std::vector<cl::Event> events;
+            to_device(events);
+        }
+
+        m_queue.finish();
+    }
+    catch (cl::Error& e)
+    {
+        std::cerr << "SharedBuffer: " << e.what() << " (" << e.err() << ")" << std::endl;
+    }
+
+    if (m_svm != nullptr)
+    {
+        clSVMFree(m_context(), m_svm);
+    }
+}
+
+BufferMode SharedBuffer::mode() const
+{
+    return m_mode;
+}
+
+std::size_t SharedBuffer::bytes() const
+{
+    return m_bytes;
+}
+
+void* SharedBuffer::host()
+{
+    return m_host;
+}
+
+void SharedBuffer::set_arg(cl::Kernel& kernel, cl_uint index) const
+{
+    if (m_svm != nullptr)
+    {
+        kernel.setArg(index, m_svm);
+    }
+    else
+    {
+        kernel.setArg(index, m_buffer);
+    }
+}
+
+void SharedBuffer::to_device(std::vector<cl::Event>& events)
+{
+    if (!m_on_host)
+    {
+        return;
+    }
+
+    cl::Event event;
+
+    switch (m_mode)
+    {
+        case BufferMode::DeviceCopy:
+            m_queue.enqueueWriteBuffer(m_buffer, CL_FALSE, 0, m_bytes, m_host, NULL, &event);
+            break;
+
+        case BufferMode::UseHostPtr:
+        case BufferMode::AllocHostPtr:
+            m_queue.enqueueUnmapMemObject(m_buffer, m_host, NULL, &event);
+            break;
+
+        case BufferMode::SvmCoarse:
+            m_queue.enqueueUnmapSVM(m_svm, NULL, &event);
+            break;
+
+        case BufferMode::SvmFine:
+            // the kernels see the host writes directly
+            break;
+    }
+
+    if (event() != nullptr)
+    {
+        events.push_back(event);
+    }
+
+    m_on_host = false;
+}
+
+void SharedBuffer::to_host(std::vector<cl::Event>& events)
+{
+    if (m_on_host)
+    {
+        return;
+    }
+
+    const cl_map_flags map_flags = CL_MAP_READ | CL_MAP_WRITE;
+
+    cl::Event event;
+
+    switch (m_mode)
+    {
+        case BufferMode::DeviceCopy:
+            m_queue.enqueueReadBuffer(m_buffer, CL_TRUE, 0, m_bytes, m_host, NULL, &event);
+            break;
+
+        case BufferMode::UseHostPtr:
+        case BufferMode::AllocHostPtr:
+            // ALLOC_HOST_PTR may map to a different address every time
+            m_host = m_queue.enqueueMapBuffer(m_buffer, CL_TRUE, map_flags, 0, m_bytes, NULL, &event);
+            break;
+
+        case BufferMode::SvmCoarse:
+            m_queue.enqueueMapSVM(m_svm, CL_TRUE, map_flags, m_bytes, NULL, &event);
+            break;
+
+        case BufferMode::SvmFine:
+            // nothing to transfer, only wait for the kernels
+            m_queue.finish();
+            break;
+    }
+
+    if (event() != nullptr)
+    {
+        events.push_back(event);
+    }
+
+    m_on_host = true;
+}
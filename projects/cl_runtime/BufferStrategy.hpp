@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ClRuntime.hpp"
+
+#include <string>
+#include <vector>
+
+// how an array is shared between the host and the device:
+//   DeviceCopy   device-resident buffer, explicit write before and read after the kernel
+//   UseHostPtr   page-aligned host array wrapped with CL_MEM_USE_HOST_PTR, mapped on the host
+//   AllocHostPtr runtime-allocated host memory (CL_MEM_ALLOC_HOST_PTR), mapped on the host
+//   SvmCoarse    coarse-grained SVM, mapped on the host (OpenCL 2.0)
+//   SvmFine      fine-grained SVM, the host uses it directly once the queue is idle
+// on a CPU device or an integrated GPU all but DeviceCopy work in place;
+// a discrete GPU copies on map and unmap instead
+enum class BufferMode
+{
+    DeviceCopy,
+    UseHostPtr,
+    AllocHostPtr,
+    SvmCoarse,
+    SvmFine
+};
+
+const char* to_string(BufferMode mode);
+
+// accepts the names printed by to_string()
+bool parse_buffer_mode(const std::string& name, BufferMode& mode);
+
+bool supports(const ClRuntime& runtime, BufferMode mode);
+
+// every mode the device supports, DeviceCopy first
+std::vector<BufferMode> supported_buffer_modes(const ClRuntime& runtime);
+
+// one array shared with the device in the given mode. it starts out owned by
+// the host; to_device() hands it to the kernels and to_host() hands it back.
+// the commands either call enqueues are appended to `events` for profiling.
+class SharedBuffer
+{
+public:
+    SharedBuffer(ClRuntime& runtime, BufferMode mode, std::size_t bytes);
+    ~SharedBuffer();
+
+    SharedBuffer(const SharedBuffer&) = delete;
+    SharedBuffer& operator=(const SharedBuffer&) = delete;
+
+    BufferMode  mode() const;
+    std::size_t bytes() const;
+
+    // valid while the host owns the buffer
+    void* host();
+
+    void set_arg(cl::Kernel& kernel, cl_uint index) const;
+
+    void to_device(std::vector<cl::Event>& events);
+    void to_host(std::vector<cl::Event>& events);
+
+private:
+    cl::Context      m_context;
+    cl::CommandQueue m_queue;
+    BufferMode       m_mode;
+    std::size_t      m_bytes;
+
+    // declared first so it outlives a UseHostPtr buffer that wraps it
+    HostArray<unsigned char> m_host_array; // DeviceCopy and UseHostPtr
+    cl::Buffer               m_buffer;
+    void*                    m_svm;
+    void*                    m_host;
+    bool                     m_on_host;
+};
+
+template <typename T>
+class SharedArray
+{
+public:
+    SharedArray(ClRuntime& runtime, BufferMode mode, std::size_t count)
+    : m_buffer(runtime, mode, count * sizeof(T)),
+      m_count(count)
+    {}
+
+    T* data()  { return static_cast<T*>(m_buffer.host()); }
+    T* begin() { return data(); }
+    T* end()   { return data() + m_count; }
+
+    T& operator[](std::size_t i) { return data()[i]; }
+
+    std::size_t size() const  { return m_count; }
+    std::size_t bytes() const { return m_buffer.bytes(); }
+    BufferMode  mode() const  { return m_buffer.mode(); }
+
+    void set_arg(cl::Kernel& kernel, cl_uint index) const { m_buffer.set_arg(kernel, index); }
+
+    void to_device(std::vector<cl::Event>& events) { m_buffer.to_device(events); }
+    void to_host(std::vector<cl::Event>& events)   { m_buffer.to_host(events); }
+
+private:
+    SharedBuffer m_buffer;
+    std::size_t  m_count;
+};
@@ -0,0 +1,458 @@
+#include "ClRuntime.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <new>
+#include <sstream>
+
+DeviceQuery DeviceQuery::from_args(int argc, char* argv[])
+{
+    DeviceQuery query;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--gpu") == 0)
+        {
+            query.types = {CL_DEVICE_TYPE_GPU};
+        }
+        else if (std::strcmp(argv[i], "--cpu") == 0)
+        {
+            query.types = {CL_DEVICE_TYPE_CPU};
+        }
+        else if (std::strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+        {
+            query.name = argv[++i];
+        }
+    }
+
+    return query;
+}
+
+cl::Device select_device(const DeviceQuery& query)
+{
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+
+    for (cl_device_type type : query.types)
+    {
+        for (cl::Platform& platform : platforms)
+        {
+            std::vector<cl::Device> devices;
+
+            try
+            {
+                platform.getDevices(type, &devices);
+            }
+            catch (cl::Error&)
+            {
+                // CL_DEVICE_NOT_FOUND, try the next platform
+                continue;
+            }
+
+            for (cl::Device& device : devices)
+            {
+                if (device.getInfo<CL_DEVICE_AVAILABLE>() &&
+                    device.getInfo<CL_DEVICE_NAME>().find(query.name) != std::string::npos)
+                {
+                    return device;
+                }
+            }
+        }
+    }
+
+    throw ClRuntimeError("No OpenCL device matches the query" + (query.name.empty() ? std::string() : " '" + query.name + "'"));
+}
+
+void print_device_info(std::ostream& out, const cl::Device& device)
+{
+    cl::Platform platform(device.getInfo<CL_DEVICE_PLATFORM>());
+
+    out << "Platform name     : " << platform.getInfo<CL_PLATFORM_NAME>() << std::endl;
+    out << "Platform vendor   : " << platform.getInfo<CL_PLATFORM_VENDOR>() << std::endl;
+    out << "Device name       : " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
+    out << "Device version    : " << device.getInfo<CL_DEVICE_VERSION>() << std::endl;
+    out << "Driver version    : " << device.getInfo<CL_DRIVER_VERSION>() << std::endl;
+    out << "Device type       : " << device.getInfo<CL_DEVICE_TYPE>() << std::endl;
+    out << "Max compute units : " << device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() << std::endl;
+    out << "Max Work group    : " << device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() << std::endl;
+
+    std::vector<size_t> wi_dims = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+
+    for (size_t i = 0; i < wi_dims.size(); ++i)
+    {
+        out << "   Dim[" << i << "]: " << wi_dims[i] << std::endl;
+    }
+
+    cl_device_svm_capabilities svm = 0;
+
+    try
+    {
+        svm = device.getInfo<CL_DEVICE_SVM_CAPABILITIES>();
+    }
+    catch (cl::Error&)
+    {
+        // OpenCL 1.x device
+    }
+
+    out << "Device SVM coarse grain : " << ((svm & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER) ? "Yes" : "No") << std::endl;
+    out << "Device SVM fine grain buffer : " << ((svm & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) ? "Yes" : "No") << std::endl;
+    out << "Device SVM fine grain system : " << ((svm & CL_DEVICE_SVM_FINE_GRAIN_SYSTEM) ? "Yes" : "No") << std::endl;
+    out << "Device SVM atomics : " << ((svm & CL_DEVICE_SVM_ATOMICS) ? "Yes" : "No") << std::endl;
+}
+
+std::string read_file(const std::string& filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+
+    if (!stream.is_open())
+    {
+        throw ClRuntimeError("Failed to read file " + filename);
+    }
+
+    return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+double elapsed_seconds(const cl::Event& event)
+{
+    cl_ulong start  = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    cl_ulong finish = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+    return static_cast<double>(finish - start) * 1.e-9;
+}
+
+double total_seconds(const std::vector<cl::Event>& events)
+{
+    double seconds = 0.0;
+
+    for (const cl::Event& event : events)
+    {
+        seconds += elapsed_seconds(event);
+    }
+
+    return seconds;
+}
+
+const char* ClRuntime::DEFAULT_CACHE_DIR = "cl_cache";
+
+// 64-bit FNV-1a
+static std::uint64_t fnv1a(const std::string& data)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static std::string to_hex(std::uint64_t value)
+{
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << value;
+    return out.str();
+}
+
+ProgramCache::ProgramCache(const cl::Context& context, const cl::Device& device, const std::string& cache_dir)
+: m_context(context),
+  m_device(device),
+  m_cache_dir(cache_dir),
+  m_binary_loads(0),
+  m_source_builds(0)
+{}
+
+void ProgramCache::set_cache_dir(const std::string& cache_dir)
+{
+    m_cache_dir = cache_dir;
+}
+
+const std::string& ProgramCache::cache_dir() const
+{
+    return m_cache_dir;
+}
+
+std::size_t ProgramCache::binary_loads() const
+{
+    return m_binary_loads;
+}
+
+std::size_t ProgramCache::source_builds() const
+{
+    return m_source_builds;
+}
+
+bool ProgramCache::loaded_from_binary(const std::string& file, const std::string& options) const
+{
+    return m_from_binary.count(file + '\n' + options) > 0;
+}
+
+// everything a binary depends on; a new driver or an edited kernel gives a new key
+std::string ProgramCache::entry_key(const std::string& file, const std::string& source, const std::string& options) const
+{
+    cl::Platform platform(m_device.getInfo<CL_DEVICE_PLATFORM>());
+
+    std::ostringstream key;
+    key << file << '\n'
+        << to_hex(fnv1a(source)) << '\n'
+        << options << '\n'
+        << platform.getInfo<CL_PLATFORM_VERSION>() << '\n'
+        << m_device.getInfo<CL_DEVICE_NAME>() << '\n'
+        << m_device.getInfo<CL_DEVICE_VERSION>() << '\n'
+        << m_device.getInfo<CL_DRIVER_VERSION>();
+    return key.str();
+}
+
+// an entry is the key, a NUL and the device binary
+bool ProgramCache::load_binary(const std::string& path, const std::string& key, const std::string& options, cl::Program& program) const
+{
+    std::ifstream stream(path, std::ios::binary);
+
+    if (!stream.is_open())
+    {
+        return false;
+    }
+
+    std::string stored_key;
+    std::getline(stream, stored_key, '\0');
+
+    // a different key under the same hash is a stale or colliding entry
+    if (!stream || stored_key != key)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> binary((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    if (binary.empty())
+    {
+        return false;
+    }
+
+    const std::vector<cl::Device> devices(1, m_device);
+
+    try
+    {
+        program = cl::Program(m_context, devices, cl::Program::Binaries(1, binary));
+        program.build(devices, options.c_str());
+    }
+    catch (cl::Error&)
+    {
+        // truncated, or rejected by the driver
+        return false;
+    }
+
+    return true;
+}
+
+void ProgramCache::store_binary(const std::string& path, const std::string& key, const cl::Program& program) const
+{
+    std::vector<std::vector<unsigned char>> binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+
+    if (binaries.empty() || binaries.front().empty())
+    {
+        return;
+    }
+
+    // the cache is best effort, a failed write only costs a rebuild next time
+    std::error_code error;
+    std::filesystem::create_directories(m_cache_dir, error);
+
+    const std::string temp_path = path + ".tmp";
+
+    {
+        std::ofstream stream(temp_path, std::ios::binary | std::ios::trunc);
+
+        if (!stream.is_open())
+        {
+            return;
+        }
+
+        stream.write(key.data(), key.size());
+        stream.put('\0');
+        stream.write(reinterpret_cast<const char*>(binaries.front().data()), binaries.front().size());
+
+        if (!stream)
+        {
+            stream.close();
+            std::filesystem::remove(temp_path, error);
+            return;
+        }
+    }
+
+    // readers never see a half-written entry
+    std::filesystem::rename(temp_path, path, error);
+}
+
+const cl::Program& ProgramCache::get(const std::string& file, const std::string& options)
+{
+    const std::string key = file + '\n' + options;
+
+    std::map<std::string, cl::Program>::iterator cached = m_programs.find(key);
+
+    if (cached != m_programs.end())
+    {
+        return cached->second;
+    }
+
+    const std::string source = read_file(file);
+
+    std::string entry;
+    std::string path;
+
+    if (!m_cache_dir.empty())
+    {
+        entry = entry_key(file, source, options);
+        path  = (std::filesystem::path(m_cache_dir) / (to_hex(fnv1a(entry)) + ".bin")).string();
+
+        cl::Program program;
+
+        if (load_binary(path, entry, options, program))
+        {
+            ++m_binary_loads;
+            m_from_binary.insert(key);
+            return m_programs.emplace(key, program).first->second;
+        }
+    }
+
+    cl::Program program(m_context, source);
+
+    try
+    {
+        program.build(std::vector<cl::Device>(1, m_device), options.c_str());
+    }
+    catch (cl::Error&)
+    {
+        throw ClRuntimeError("Failed to build " + file + " (" + options + "):\n" +
+                             program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_device));
+    }
+
+    ++m_source_builds;
+
+    if (!m_cache_dir.empty())
+    {
+        store_binary(path, entry, program);
+    }
+
+    return m_programs.emplace(key, program).first->second;
+}
+
+ClRuntime::ClRuntime(const DeviceQuery& query,
+                     std::size_t num_queues,
+                     cl_command_queue_properties properties)
+: ClRuntime(select_device(query), num_queues, properties)
+{}
+
+ClRuntime::ClRuntime(const cl::Device& device,
+                     std::size_t num_queues,
+                     cl_command_queue_properties properties)
+: m_device(device),
+  m_context(device),
+  m_programs(m_context, m_device, DEFAULT_CACHE_DIR)
+{
+    for (std::size_t i = 0; i < std::max<std::size_t>(num_queues, 1); ++i)
+    {
+        m_queues.push_back(cl::CommandQueue(m_context, m_device, properties));
+    }
+}
+
+const cl::Context& ClRuntime::context() const
+{
+    return m_context;
+}
+
+const cl::Device& ClRuntime::device() const
+{
+    return m_device;
+}
+
+cl::CommandQueue& ClRuntime::queue(std::size_t index)
+{
+    return m_queues.at(index);
+}
+
+std::size_t ClRuntime::num_queues() const
+{
+    return m_queues.size();
+}
+
+const cl::Program& ClRuntime::program(const std::string& file, const std::string& options)
+{
+    return m_programs.get(file, options);
+}
+
+cl::Kernel ClRuntime::kernel(const std::string& file, const std::string& name, const std::string& options)
+{
+    return cl::Kernel(program(file, options), name.c_str());
+}
+
+void ClRuntime::set_binary_cache(const std::string& cache_dir)
+{
+    m_programs.set_cache_dir(cache_dir);
+}
+
+const ProgramCache& ClRuntime::programs() const
+{
+    return m_programs;
+}
+
+std::string ClRuntime::device_name() const
+{
+    return m_device.getInfo<CL_DEVICE_NAME>();
+}
+
+bool ClRuntime::has_svm(cl_device_svm_capabilities capabilities) const
+{
+    try
+    {
+        return (m_device.getInfo<CL_DEVICE_SVM_CAPABILITIES>() & capabilities) == capabilities;
+    }
+    catch (cl::Error&)
+    {
+        // OpenCL 1.x device
+        return false;
+    }
+}
+
+void ClRuntime::finish()
+{
+    for (cl::CommandQueue& queue : m_queues)
+    {
+        queue.finish();
+    }
+}
+
+void* aligned_host_alloc(std::size_t bytes, std::size_t alignment)
+{
+    // the size has to be a multiple of the alignment
+    bytes = (bytes + alignment - 1) / alignment * alignment;
+
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(bytes, alignment);
+#else
+    void* ptr = std::aligned_alloc(alignment, bytes);
+#endif
+
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void aligned_host_free(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#ifndef CL_HPP_ENABLE_EXCEPTIONS
+#define CL_HPP_ENABLE_EXCEPTIONS
+#endif
+
+#ifndef CL_HPP_TARGET_OPENCL_VERSION
+#define CL_HPP_TARGET_OPENCL_VERSION 210
+#endif
+
+#include <CL/opencl.hpp>
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// small OpenCL runtime shared by the sandboxes: device selection, context,
+// queues, a program cache and RAII memory. failing OpenCL calls throw
+// cl::Error, everything else throws ClRuntimeError; nothing calls exit().
+
+class ClRuntimeError : public std::runtime_error
+{
+public:
+    explicit ClRuntimeError(const std::string& what)
+    : std::runtime_error(what)
+    {}
+};
+
+// which device to run on: the first device of the first listed type whose
+// name contains `name`, searching the platforms in order. the default
+// prefers a GPU and falls back to a CPU runtime such as PoCL.
+struct DeviceQuery
+{
+    std::vector<cl_device_type> types = {CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_CPU};
+    std::string                 name;
+
+    // understands --gpu, --cpu and --device NAME, other arguments are skipped
+    static DeviceQuery from_args(int argc, char* argv[]);
+};
+
+cl::Device select_device(const DeviceQuery& query = DeviceQuery());
+
+void print_device_info(std::ostream& out, const cl::Device& device);
+
+std::string read_file(const std::string& filename);
+
+// seconds between the start and the end of a command on a profiling queue
+double elapsed_seconds(const cl::Event& event);
+
+// the sum of elapsed_seconds() over a list of commands
+double total_seconds(const std::vector<cl::Event>& events);
+
+// builds every (source file, options) pair once; a failed build throws with the build log.
+// with a cache directory the binaries are also kept on disk under a hash of the source,
+// the options and the device and driver versions, so later runs skip the compiler.
+// an entry that does not match or does not load is rebuilt from source and replaced.
+class ProgramCache
+{
+public:
+    ProgramCache(const cl::Context& context, const cl::Device& device, const std::string& cache_dir = "");
+
+    const cl::Program& get(const std::string& file, const std::string& options = "");
+
+    // an empty directory keeps the binaries in memory only
+    void               set_cache_dir(const std::string& cache_dir);
+    const std::string& cache_dir() const;
+
+    std::size_t binary_loads() const;
+    std::size_t source_builds() const;
+
+    // true when get(file, options) was served by a cached binary
+    bool loaded_from_binary(const std::string& file, const std::string& options = "") const;
+
+private:
+    std::string entry_key(const std::string& file, const std::string& source, const std::string& options) const;
+    bool        load_binary(const std::string& path, const std::string& key, const std::string& options, cl::Program& program) const;
+    void        store_binary(const std::string& path, const std::string& key, const cl::Program& program) const;
+
+    cl::Context                        m_context;
+    cl::Device                         m_device;
+    std::map<std::string, cl::Program> m_programs;
+    std::set<std::string>              m_from_binary; // keys of m_programs loaded from disk
+    std::string                        m_cache_dir;
+    std::size_t                        m_binary_loads;
+    std::size_t                        m_source_builds;
+};
+
+// one device with its own context, queues and programs. runtimes share no
+// state, so several devices or contexts can be used in the same process.
+class ClRuntime
+{
+public:
+    // program binaries are cached here unless set_binary_cache("") turns it off
+    static const char* DEFAULT_CACHE_DIR;
+
+    explicit ClRuntime(const DeviceQuery& query,
+                       std::size_t num_queues = 1,
+                       cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE);
+
+    explicit ClRuntime(const cl::Device& device,
+                       std::size_t num_queues = 1,
+                       cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE);
+
+    const cl::Context& context() const;
+    const cl::Device&  device() const;
+
+    cl::CommandQueue& queue(std::size_t index = 0);
+    std::size_t       num_queues() const;
+
+    const cl::Program& program(const std::string& file, const std::string& options = "");
+    cl::Kernel         kernel(const std::string& file, const std::string& name, const std::string& options = "");
+
+    void                set_binary_cache(const std::string& cache_dir);
+    const ProgramCache& programs() const;
+
+    std::string device_name() const;
+    bool        has_svm(cl_device_svm_capabilities capabilities) const;
+
+    // waits for every queue
+    void finish();
+
+private:
+    cl::Device                    m_device;
+    cl::Context                   m_context;
+    std::vector<cl::CommandQueue> m_queues;
+    ProgramCache                  m_programs;
+};
+
+void* aligned_host_alloc(std::size_t bytes, std::size_t alignment);
+void  aligned_host_free(void* ptr);
+
+// page-aligned host array. CL_MEM_USE_HOST_PTR buffers over it stay
+// zero-copy on CPU devices and integrated GPUs.
+template <typename T>
+class HostArray
+{
+public:
+    static const std::size_t ALIGNMENT = 4096;
+
+    explicit HostArray(std::size_t count = 0)
+    : m_data(count ? static_cast<T*>(aligned_host_alloc(count * sizeof(T), ALIGNMENT)) : nullptr),
+      m_count(count)
+    {}
+
+    HostArray(HostArray&& other)
+    : m_data(other.m_data),
+      m_count(other.m_count)
+    {
+        other.m_data  = nullptr;
+        other.m_count = 0;
+    }
+
+    HostArray& operator=(HostArray&& other)
+    {
+        std::swap(m_data, other.m_data);
+        std::swap(m_count, other.m_count);
+        return *this;
+    }
+
+    HostArray(const HostArray&) = delete;
+    HostArray& operator=(const HostArray&) = delete;
+
+    ~HostArray()
+    {
+        aligned_host_free(m_data);
+    }
+
+    T*       data()        { return m_data; }
+    const T* data() const  { return m_data; }
+    T*       begin()       { return m_data; }
+    T*       end()         { return m_data + m_count; }
+    std::size_t size() const  { return m_count; }
+    std::size_t bytes() const { return m_count * sizeof(T); }
+
+    T&       operator[](std::size_t i)       { return m_data[i]; }
+    const T& operator[](std::size_t i) const { return m_data[i]; }
+
+private:
+    T*          m_data;
+    std::size_t m_count;
+};
+
+// buffer that knows its element type and count
+template <typename T>
+class DeviceBuffer
+{
+public:
+    DeviceBuffer()
+    : m_count(0)
+    {}
+
+    DeviceBuffer(const cl::Context& context,
+                 std::size_t count,
+                 cl_mem_flags flags = CL_MEM_READ_WRITE,
+                 T* host_ptr = nullptr)
+    : m_buffer(context, flags, count * sizeof(T), host_ptr),
+      m_count(count)
+    {}
+
+    const cl::Buffer& get() const { return m_buffer; }
+    std::size_t size() const      { return m_count; }
+    std::size_t bytes() const     { return m_count * sizeof(T); }
+
+    void write(cl::CommandQueue& queue, const T* data, bool blocking = true)
+    {
+        queue.enqueueWriteBuffer(m_buffer, blocking ? CL_TRUE : CL_FALSE, 0, bytes(), data);
+    }
+
+    void read(cl::CommandQueue& queue, T* data, bool blocking = true) const
+    {
+        queue.enqueueReadBuffer(m_buffer, blocking ? CL_TRUE : CL_FALSE, 0, bytes(), data);
+    }
+
+private:
+    cl::Buffer  m_buffer;
+    std::size_t m_count;
+};
+
+// shared virtual memory array (OpenCL 2.0), freed with its context
+template <typename T>
+class SvmArray
+{
+public:
+    SvmArray(const cl::Context& context, std::size_t count, cl_svm_mem_flags flags = CL_MEM_READ_WRITE)
+    : m_context(context),
+      m_data(static_cast<T*>(clSVMAlloc(context(), flags, count * sizeof(T), 0))),
+      m_count(count)
+    {
+        if (m_data == nullptr && count > 0)
+        {
+            throw ClRuntimeError("clSVMAlloc() failed");
+        }
+    }
+
+    SvmArray(const SvmArray&) = delete;
+    SvmArray& operator=(const SvmArray&) = delete;
+
+    ~SvmArray()
+    {
+        if (m_data != nullptr)
+        {
+            clSVMFree(m_context(), m_data);
+        }
+    }
+
+    T*       data()        { return m_data; }
+    const T* data() const  { return m_data; }
+    std::size_t size() const  { return m_count; }
+    std::size_t bytes() const { return m_count * sizeof(T); }
+
+    T&       operator[](std::size_t i)       { return m_data[i]; }
+    const T& operator[](std::size_t i) const { return m_data[i]; }
+
+private:
+    cl::Context m_context;
+    T*          m_data;
+    std::size_t m_count;
+};
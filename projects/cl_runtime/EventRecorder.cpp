@@ -0,0 +1,239 @@
+#include "EventRecorder.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+
+void EventRecorder::record(const cl::Event& event, const std::string& name, std::size_t queue, const std::string& category)
+{
+    Command command;
+    command.event    = event;
+    command.name     = name;
+    command.category = category;
+    command.queue    = queue;
+
+    m_commands.push_back(command);
+}
+
+void EventRecorder::record(const std::vector<cl::Event>& events, const std::string& name, std::size_t queue, const std::string& category)
+{
+    for (const cl::Event& event : events)
+    {
+        record(event, name, queue, category);
+    }
+}
+
+std::size_t EventRecorder::size() const
+{
+    return m_commands.size();
+}
+
+void EventRecorder::clear()
+{
+    m_commands.clear();
+}
+
+std::vector<EventRecorder::Timing> EventRecorder::timings() const
+{
+    std::vector<Timing> result;
+    result.reserve(m_commands.size());
+
+    for (const Command& command : m_commands)
+    {
+        command.event.wait();
+
+        Timing timing;
+        timing.command = &command;
+        timing.queued  = command.event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+        timing.submit  = command.event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>();
+        timing.start   = command.event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        timing.end     = command.event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+        result.push_back(timing);
+    }
+
+    return result;
+}
+
+static std::string json_string(const std::string& text)
+{
+    std::string result = "\"";
+
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+        }
+
+        result += c;
+    }
+
+    return result + "\"";
+}
+
+// trace timestamps are microseconds
+static double micros(cl_ulong nanoseconds)
+{
+    return static_cast<double>(nanoseconds) * 1.e-3;
+}
+
+void EventRecorder::write_chrome_trace(std::ostream& out) const
+{
+    const std::vector<Timing> commands = timings();
+
+    // every queue of a device shares the device clock
+    cl_ulong origin = std::numeric_limits<cl_ulong>::max();
+    std::size_t num_queues = 0;
+
+    for (const Timing& timing : commands)
+    {
+        origin     = std::min(origin, timing.queued);
+        num_queues = std::max(num_queues, timing.command->queue + 1);
+    }
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+
+    // track 2q runs the commands of queue q, track 2q + 1 shows their launch latency
+    for (std::size_t queue = 0; queue < num_queues; ++queue)
+    {
+        out << (queue > 0 ? ",\n" : "\n")
+            << "  {\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 0, \"tid\": " << 2 * queue
+            << ", \"args\": {\"name\": \"queue " << queue << "\"}},\n";
+        out << "  {\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 0, \"tid\": " << 2 * queue + 1
+            << ", \"args\": {\"name\": \"queue " << queue << " launch\"}}";
+    }
+
+    for (const Timing& timing : commands)
+    {
+        const Command& command = *timing.command;
+
+        out << ",\n  {\"ph\": \"X\", \"name\": " << json_string(command.name)
+            << ", \"cat\": " << json_string(command.category)
+            << ", \"pid\": 0, \"tid\": " << 2 * command.queue
+            << ", \"ts\": " << micros(timing.start - origin)
+            << ", \"dur\": " << micros(timing.end - timing.start)
+            << ", \"args\": {\"queued_us\": " << micros(timing.queued - origin)
+            << ", \"submit_us\": " << micros(timing.submit - origin)
+            << ", \"launch_us\": " << micros(timing.start - timing.queued) << "}},\n";
+
+        out << "  {\"ph\": \"X\", \"name\": " << json_string(command.name)
+            << ", \"cat\": \"launch\""
+            << ", \"pid\": 0, \"tid\": " << 2 * command.queue + 1
+            << ", \"ts\": " << micros(timing.queued - origin)
+            << ", \"dur\": " << micros(timing.start - timing.queued) << "}";
+    }
+
+    out << "\n]}" << std::endl;
+
+    out.unsetf(std::ios::floatfield);
+}
+
+void EventRecorder::save_chrome_trace(const std::string& filename) const
+{
+    std::ofstream stream(filename, std::ios::trunc);
+
+    if (!stream.is_open())
+    {
+        throw ClRuntimeError("Failed to write trace " + filename);
+    }
+
+    write_chrome_trace(stream);
+}
+
+void EventRecorder::print_summary(std::ostream& out) const
+{
+    struct NameTotals
+    {
+        std::size_t count  = 0;
+        double      total  = 0.0;
+        double      min    = std::numeric_limits<double>::max();
+        double      max    = 0.0;
+        double      launch = 0.0;
+    };
+
+    struct QueueTotals
+    {
+        double   busy  = 0.0;
+        cl_ulong first = std::numeric_limits<cl_ulong>::max();
+        cl_ulong last  = 0;
+    };
+
+    const std::vector<Timing> commands = timings();
+
+    // names in the order they were first recorded
+    std::vector<std::string>          names;
+    std::map<std::string, NameTotals> by_name;
+    std::map<std::size_t, QueueTotals> by_queue;
+
+    for (const Timing& timing : commands)
+    {
+        const double seconds = static_cast<double>(timing.end - timing.start) * 1.e-9;
+
+        if (by_name.count(timing.command->name) == 0)
+        {
+            names.push_back(timing.command->name);
+        }
+
+        NameTotals& name = by_name[timing.command->name];
+        name.count  += 1;
+        name.total  += seconds;
+        name.min     = std::min(name.min, seconds);
+        name.max     = std::max(name.max, seconds);
+        name.launch += static_cast<double>(timing.start - timing.queued) * 1.e-9;
+
+        // commands of one in-order queue never overlap, so their times add up
+        QueueTotals& queue = by_queue[timing.command->queue];
+        queue.busy  += seconds;
+        queue.first  = std::min(queue.first, timing.start);
+        queue.last   = std::max(queue.last, timing.end);
+    }
+
+    out << std::fixed << std::setprecision(3);
+
+    out << std::left << std::setw(24) << "command" << std::right
+        << std::setw(8)  << "count"
+        << std::setw(12) << "total ms"
+        << std::setw(12) << "mean ms"
+        << std::setw(12) << "min ms"
+        << std::setw(12) << "max ms"
+        << std::setw(14) << "launch ms" << std::endl;
+
+    for (const std::string& name : names)
+    {
+        const NameTotals& totals = by_name[name];
+
+        out << std::left << std::setw(24) << name << std::right
+            << std::setw(8)  << totals.count
+            << std::setw(12) << totals.total * 1.0e3
+            << std::setw(12) << totals.total / totals.count * 1.0e3
+            << std::setw(12) << totals.min * 1.0e3
+            << std::setw(12) << totals.max * 1.0e3
+            << std::setw(14) << totals.launch / totals.count * 1.0e3 << std::endl;
+    }
+
+    out << std::left << std::setw(24) << "queue" << std::right
+        << std::setw(8)  << ""
+        << std::setw(12) << "busy ms"
+        << std::setw(12) << "span ms"
+        << std::setw(12) << "idle ms"
+        << std::setw(12) << "busy %" << std::endl;
+
+    for (const auto& entry : by_queue)
+    {
+        const QueueTotals& totals = entry.second;
+        const double       span   = static_cast<double>(totals.last - totals.first) * 1.e-9;
+
+        out << std::left << std::setw(24) << ("queue " + std::to_string(entry.first)) << std::right
+            << std::setw(8)  << ""
+            << std::setw(12) << totals.busy * 1.0e3
+            << std::setw(12) << span * 1.0e3
+            << std::setw(12) << std::max(span - totals.busy, 0.0) * 1.0e3
+            << std::setw(12) << (span > 0.0 ? 100.0 * totals.busy / span : 0.0) << std::endl;
+    }
+
+    out.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ClRuntime.hpp"
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// collects the profiled commands of every queue and reports them once they
+// have finished. each command keeps its four timestamps:
+//   queued  the host enqueued it
+//   submit  the runtime handed it to the device
+//   start   the device started it
+//   end     the device finished it
+// queued to start is the launch overhead, gaps between commands of a queue
+// are bubbles the device spent idle. the queues need CL_QUEUE_PROFILING_ENABLE.
+class EventRecorder
+{
+public:
+    // `category` groups commands in the trace, e.g. the buffer mode of a run
+    void record(const cl::Event& event, const std::string& name, std::size_t queue = 0, const std::string& category = "");
+    void record(const std::vector<cl::Event>& events, const std::string& name, std::size_t queue = 0, const std::string& category = "");
+
+    std::size_t size() const;
+    void        clear();
+
+    // trace-event JSON for chrome://tracing or ui.perfetto.dev: one track
+    // per queue with the commands as they ran, and one with their launch
+    // latency, all relative to the first command queued
+    void write_chrome_trace(std::ostream& out) const;
+    void save_chrome_trace(const std::string& filename) const;
+
+    // per command name: count, total, mean, min, max and mean launch
+    // latency; per queue: busy time, span and idle time between commands
+    void print_summary(std::ostream& out) const;
+
+private:
+    struct Command
+    {
+        cl::Event   event;
+        std::string name;
+        std::string category;
+        std::size_t queue;
+    };
+
+    struct Timing
+    {
+        const Command* command;
+        cl_ulong       queued;
+        cl_ulong       submit;
+        cl_ulong       start;
+        cl_ulong       end;
+    };
+
+    // reads the timestamps, waiting for commands that are still running
+    std::vector<Timing> timings() const;
+
+    std::vector<Command> m_commands;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "WorkerPool.hpp"
+
+// helpers for the host baselines the device numbers are compared against:
+// a steady wall clock, a thread fan-out and a speedup table
+
+class HostTimer
+{
+public:
+    HostTimer()
+    : m_start(std::chrono::steady_clock::now())
+    {}
+
+    void restart()
+    {
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    double seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// the fastest of `iterations` runs of body()
+template <typename Body>
+double best_seconds(int iterations, Body body)
+{
+    double best_time = std::numeric_limits<double>::max();
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        HostTimer timer;
+        body();
+        best_time = std::min(best_time, timer.seconds());
+    }
+
+    return best_time;
+}
+
+inline std::size_t host_threads()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// a pool of num_threads threads, started on first use and kept until the
+// process exits, so the timed baselines never pay for creating threads
+inline WorkerPool& host_pool(std::size_t num_threads)
+{
+    static std::mutex                                         mutex;
+    static std::map<std::size_t, std::unique_ptr<WorkerPool>> pools;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::unique_ptr<WorkerPool>& pool = pools[num_threads];
+
+    if (!pool)
+    {
+        pool.reset(new WorkerPool(static_cast<unsigned int>(num_threads)));
+    }
+
+    return *pool;
+}
+
+// runs body(begin, end) over [0, count) in one contiguous chunk per thread
+// of host_pool(num_threads), the calling thread takes the first chunk.
+// body must not call parallel_for itself.
+template <typename Body>
+void parallel_for(std::size_t count, Body body, std::size_t num_threads = host_threads())
+{
+    num_threads = std::max<std::size_t>(std::min(num_threads, count), 1);
+
+    host_pool(num_threads).parallel_for(count, 1, [&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        body(begin, end);
+    });
+}
+
+// one timing of the table. rows of the same group are compared with the
+// first row of their group, normally the naive host loop.
+struct SpeedupRow
+{
+    std::string group;
+    std::string name;
+    double      seconds;
+};
+
+inline void print_speedup_table(std::ostream& out, const std::vector<SpeedupRow>& rows)
+{
+    out << std::left << std::setw(16) << "benchmark"
+        << std::setw(28) << "version" << std::right
+        << std::setw(12) << "ms"
+        << std::setw(12) << "speedup" << std::endl;
+
+    out << std::fixed;
+
+    for (std::size_t i = 0; i < rows.size(); ++i)
+    {
+        std::size_t first = i;
+
+        while (first > 0 && rows[first - 1].group == rows[i].group)
+        {
+            --first;
+        }
+
+        const double baseline = rows[first].seconds;
+
+        out << std::left << std::setw(16) << (first == i ? rows[i].group : "")
+            << std::setw(28) << rows[i].name << std::right
+            << std::setprecision(3) << std::setw(12) << rows[i].seconds * 1.0e3
+            << std::setprecision(2) << std::setw(11) << (rows[i].seconds > 0.0 ? baseline / rows[i].seconds : 0.0) << "x"
+            << std::endl;
+    }
+
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+}
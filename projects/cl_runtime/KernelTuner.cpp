@@ -0,0 +1,315 @@
+#include "KernelTuner.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+// each point is timed this many times and the fastest run counts
+static const int TUNE_REPEATS = 3;
+
+// smaller work-groups never win and only make the sweep longer
+static const std::size_t MIN_LOCAL_SIZE = 16;
+
+std::string KernelConfig::build_options() const
+{
+    return " -D ITEMS_PER_WORK_ITEM=" + std::to_string(items_per_work_item) +
+           " -D VECTOR_WIDTH=" + std::to_string(vector_width);
+}
+
+std::size_t KernelConfig::group_elements() const
+{
+    return local_size * items_per_work_item * vector_width;
+}
+
+std::size_t KernelConfig::global_size(std::size_t count) const
+{
+    return (count + group_elements() - 1) / group_elements() * local_size;
+}
+
+std::ostream& operator<<(std::ostream& out, const KernelConfig& config)
+{
+    return out << "local " << config.local_size
+               << ", items " << config.items_per_work_item
+               << ", width " << config.vector_width;
+}
+
+// tabs and line breaks would split an entry of the tuning file
+static std::string sanitize(std::string text)
+{
+    std::replace(text.begin(), text.end(), '\t', ' ');
+    std::replace(text.begin(), text.end(), '\n', ' ');
+    std::replace(text.begin(), text.end(), '\r', ' ');
+    return text;
+}
+
+const char* KernelTuner::DEFAULT_FILE = "cl_cache/tuning.txt";
+
+KernelTuner::KernelTuner(ClRuntime& runtime, const std::string& file)
+: m_runtime(runtime),
+  m_file(file),
+  m_device_key(sanitize(runtime.device().getInfo<CL_DEVICE_NAME>() + " / " +
+                        runtime.device().getInfo<CL_DRIVER_VERSION>()))
+{
+    load();
+}
+
+bool KernelTuner::requested(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--tune") == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void KernelTuner::add_kernel(const std::string& name,
+                             const cl::Kernel& probe,
+                             const TuneSpace& space,
+                             const KernelConfig& fallback,
+                             TuneBenchmark benchmark)
+{
+    Entry entry;
+    entry.local_sizes = local_sizes(probe, space);
+    entry.space       = space;
+    entry.fallback    = fallback;
+    entry.benchmark   = benchmark;
+
+    // the fallback has to launch on this device as well
+    if (entry.fallback.local_size > entry.local_sizes.back())
+    {
+        entry.fallback.local_size = entry.local_sizes.back();
+    }
+
+    m_kernels[name] = entry;
+}
+
+KernelConfig KernelTuner::config(const std::string& name) const
+{
+    std::map<std::string, std::map<std::string, Result>>::const_iterator device = m_results.find(m_device_key);
+
+    if (device != m_results.end())
+    {
+        std::map<std::string, Result>::const_iterator result = device->second.find(name);
+
+        if (result != device->second.end())
+        {
+            return result->second.config;
+        }
+    }
+
+    std::map<std::string, Entry>::const_iterator entry = m_kernels.find(name);
+
+    if (entry == m_kernels.end())
+    {
+        throw ClRuntimeError("Kernel " + name + " is not registered with the tuner");
+    }
+
+    return entry->second.fallback;
+}
+
+bool KernelTuner::is_tuned(const std::string& name) const
+{
+    std::map<std::string, std::map<std::string, Result>>::const_iterator device = m_results.find(m_device_key);
+
+    return device != m_results.end() && device->second.count(name) != 0;
+}
+
+void KernelTuner::tune(std::ostream& log)
+{
+    for (const auto& kernel : m_kernels)
+    {
+        tune(kernel.first, log);
+    }
+}
+
+void KernelTuner::tune(const std::string& name, std::ostream& log)
+{
+    std::map<std::string, Entry>::iterator entry = m_kernels.find(name);
+
+    if (entry == m_kernels.end())
+    {
+        throw ClRuntimeError("Kernel " + name + " is not registered with the tuner");
+    }
+
+    Result best;
+    best.seconds = std::numeric_limits<double>::max();
+
+    log << "Tuning " << name << " on " << m_device_key << std::endl;
+
+    for (std::size_t local_size : entry->second.local_sizes)
+    {
+        for (std::size_t items : entry->second.space.items_per_work_item)
+        {
+            for (std::size_t width : entry->second.space.vector_widths)
+            {
+                KernelConfig config;
+                config.local_size          = local_size;
+                config.items_per_work_item = items;
+                config.vector_width        = width;
+
+                double seconds = std::numeric_limits<double>::max();
+
+                try
+                {
+                    for (int repeat = 0; repeat < TUNE_REPEATS; ++repeat)
+                    {
+                        seconds = std::min(seconds, entry->second.benchmark(config));
+                    }
+                }
+                catch (std::exception& e)
+                {
+                    // e.g. too many resources for this work-group size
+                    log << "  " << config << " : skipped (" << e.what() << ")" << std::endl;
+                    continue;
+                }
+
+                log << "  " << config << " : " << seconds * 1.0e3 << " ms" << std::endl;
+
+                if (seconds < best.seconds)
+                {
+                    best.config  = config;
+                    best.seconds = seconds;
+                }
+            }
+        }
+    }
+
+    if (best.seconds == std::numeric_limits<double>::max())
+    {
+        throw ClRuntimeError("No configuration of " + name + " could be launched");
+    }
+
+    log << "Best " << name << " : " << best.config << " (" << best.seconds * 1.0e3 << " ms)" << std::endl;
+
+    m_results[m_device_key][name] = best;
+    save();
+}
+
+std::vector<std::size_t> KernelTuner::local_sizes(const cl::Kernel& probe, const TuneSpace& space) const
+{
+    const cl::Device& device = m_runtime.device();
+
+    // the device, its first dimension and the compiled kernel each bound the work-group
+    std::size_t limit = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+    limit = std::min(limit, device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>().front());
+    limit = std::min(limit, probe.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+
+    std::vector<std::size_t> sizes;
+
+    if (space.local_sizes.empty())
+    {
+        const std::size_t multiple = probe.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+
+        std::size_t size = 1;
+
+        while (size < std::max(multiple, MIN_LOCAL_SIZE))
+        {
+            size *= 2;
+        }
+
+        for (; size <= limit; size *= 2)
+        {
+            sizes.push_back(size);
+        }
+    }
+    else
+    {
+        for (std::size_t size : space.local_sizes)
+        {
+            if (size <= limit)
+            {
+                sizes.push_back(size);
+            }
+        }
+    }
+
+    if (sizes.empty())
+    {
+        sizes.push_back(limit);
+    }
+
+    return sizes;
+}
+
+void KernelTuner::load()
+{
+    std::ifstream stream(m_file);
+
+    // no file yet means nothing has been tuned
+    std::string line;
+
+    while (std::getline(stream, line))
+    {
+        std::istringstream fields(line);
+
+        std::string device;
+        std::string kernel;
+        Result      result;
+
+        if (std::getline(fields, device, '\t') &&
+            std::getline(fields, kernel, '\t') &&
+            fields >> result.config.local_size
+                   >> result.config.items_per_work_item
+                   >> result.config.vector_width
+                   >> result.seconds)
+        {
+            m_results[device][kernel] = result;
+        }
+    }
+}
+
+void KernelTuner::save() const
+{
+    // like the program cache, a failed write only costs a sweep next time
+    std::error_code error;
+    const std::filesystem::path parent = std::filesystem::path(m_file).parent_path();
+
+    if (!parent.empty())
+    {
+        std::filesystem::create_directories(parent, error);
+    }
+
+    const std::string temp_path = m_file + ".tmp";
+
+    {
+        std::ofstream stream(temp_path, std::ios::trunc);
+
+        if (!stream.is_open())
+        {
+            return;
+        }
+
+        stream << std::setprecision(9);
+
+        for (const auto& device : m_results)
+        {
+            for (const auto& kernel : device.second)
+            {
+                const Result& result = kernel.second;
+
+                stream << device.first << '\t' << kernel.first << '\t'
+                       << result.config.local_size << '\t'
+                       << result.config.items_per_work_item << '\t'
+                       << result.config.vector_width << '\t'
+                       << result.seconds << '\n';
+            }
+        }
+
+        if (!stream)
+        {
+            stream.close();
+            std::filesystem::remove(temp_path, error);
+            return;
+        }
+    }
+
+    std::filesystem::rename(temp_path, m_file, error);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ClRuntime.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// launch shape of a kernel. the kernel sees the last two as build options:
+//   ITEMS_PER_WORK_ITEM elements each work-item processes
+//   VECTOR_WIDTH        elements moved by each load
+struct KernelConfig
+{
+    std::size_t local_size          = 256;
+    std::size_t items_per_work_item = 1;
+    std::size_t vector_width        = 1;
+
+    std::string build_options() const;
+
+    // elements one work-group covers
+    std::size_t group_elements() const;
+
+    // whole work-groups covering count elements
+    std::size_t global_size(std::size_t count) const;
+};
+
+std::ostream& operator<<(std::ostream& out, const KernelConfig& config);
+
+// the values swept for one kernel. an empty list of local sizes means every
+// power of two from the preferred work-group multiple (at least 16) up to
+// what the device and the kernel allow.
+struct TuneSpace
+{
+    std::vector<std::size_t> local_sizes;
+    std::vector<std::size_t> items_per_work_item = {1};
+    std::vector<std::size_t> vector_widths       = {1};
+};
+
+// times one configuration in seconds, normally from profiling events. a
+// configuration the kernel cannot launch with throws and is skipped.
+using TuneBenchmark = std::function<double(const KernelConfig&)>;
+
+// sweeps the registered kernels and keeps the fastest configuration of each
+// per device (name and driver version) in a text file, so later runs launch
+// with it without sweeping again:
+//   device <TAB> kernel <TAB> local size <TAB> items <TAB> width <TAB> seconds
+class KernelTuner
+{
+public:
+    static const char* DEFAULT_FILE;
+
+    explicit KernelTuner(ClRuntime& runtime, const std::string& file = DEFAULT_FILE);
+
+    // true when the command line asks for a sweep (--tune)
+    static bool requested(int argc, char* argv[]);
+
+    // `probe` is a kernel built from the same source, it bounds the local sizes
+    void add_kernel(const std::string& name,
+                    const cl::Kernel& probe,
+                    const TuneSpace& space,
+                    const KernelConfig& fallback,
+                    TuneBenchmark benchmark);
+
+    // the tuned configuration for this device, otherwise the fallback
+    KernelConfig config(const std::string& name) const;
+    bool         is_tuned(const std::string& name) const;
+
+    // sweeps every registered kernel, prints each point and saves the winners
+    void tune(std::ostream& log);
+    void tune(const std::string& name, std::ostream& log);
+
+private:
+    struct Entry
+    {
+        std::vector<std::size_t> local_sizes;
+        TuneSpace                space;
+        KernelConfig             fallback;
+        TuneBenchmark            benchmark;
+    };
+
+    struct Result
+    {
+        KernelConfig config;
+        double       seconds;
+    };
+
+    std::vector<std::size_t> local_sizes(const cl::Kernel& probe, const TuneSpace& space) const;
+
+    void load();
+    void save() const;
+
+    ClRuntime&                    m_runtime;
+    std::string                   m_file;
+    std::string                   m_device_key;
+    std::map<std::string, Entry>  m_kernels;
+
+    // keyed by device, then kernel; other devices' results are kept as they are
+    std::map<std::string, std::map<std::string, Result>> m_results;
+};
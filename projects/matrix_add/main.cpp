@@ -1,56 +1,392 @@
+#include "ClRuntime.hpp"
+#include "HostBaseline.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <string>
 #include <vector>
 
-#define CL_HPP_ENABLE_EXCEPTIONS
-#define CL_HPP_TARGET_OPENCL_VERSION 200
+#define RED   "\x1B[31m"
+#define GRN   "\x1B[32m"
+#define RESET "\x1B[0m"
+
+// dense n x n float matrices: element-wise add, transpose and a tiled GEMM,
+// each timed on the device and verified against a blocked host version
 
-// OpenCL includes
-#include <CL/cl2.hpp>
+const size_t MATRIX_SIZES[]  = {256u, 512u, 1024u};
+const size_t TRANSPOSE_TILE  = 16u;
+const size_t HOST_BLOCK      = 64u;   // edge of the cache blocks of the host GEMM
+const int    ITERATIONS      = 5;     // the best run is reported
+const char*  KERNEL_FILE     = "matrix_add.cl";
+
+struct OpResult
+{
+    double device_seconds;
+    double host_seconds;
+    bool   passed;
+};
+
+// reads --tile N, the GEMM tile edge, which must be a multiple of 4
+static size_t gemm_tile(int argc, char* argv[])
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--tile") == 0)
+        {
+            const size_t tile = static_cast<size_t>(std::atoi(argv[i + 1]));
 
+            if (tile == 0 || tile % 4 != 0)
+            {
+                throw ClRuntimeError("--tile must be a positive multiple of 4");
+            }
+
+            return tile;
+        }
+    }
+
+    return 16u;
+}
+
+// build options of the program, shared by all three kernels
+static std::string kernel_options(size_t tile)
+{
+    return "-cl-std=CL1.2 -D TILE=" + std::to_string(tile) +
+           " -D TRANSPOSE_TILE=" + std::to_string(TRANSPOSE_TILE);
+}
+
+// whether kernel `name` can launch with a size_x x size_y work-group that
+// uses local_bytes of local memory. the device limits are checked before the
+// program is built, the compiled kernel can allow less than the device.
+static bool group_fits(ClRuntime& runtime, const char* name, size_t tile,
+                       size_t size_x, size_t size_y, size_t local_bytes)
+{
+    const cl::Device& device = runtime.device();
+
+    const std::vector<size_t> max_items = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+
+    if (size_x * size_y > device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() ||
+        max_items.size() < 2 || size_x > max_items[0] || size_y > max_items[1] ||
+        local_bytes > device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>())
+    {
+        return false;
+    }
+
+    cl::Kernel kernel = runtime.kernel(KERNEL_FILE, name, kernel_options(tile));
+
+    return size_x * size_y <= kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+}
+
+// a GEMM work-group is tile / 4 x tile work-items and stages a tile of a and b
+static bool gemm_tile_fits(ClRuntime& runtime, size_t tile)
+{
+    return group_fits(runtime, "gemm", tile, tile / 4, tile, 2 * tile * tile * sizeof(cl_float));
+}
+
+// the transpose tile is padded by one column against bank conflicts
+static bool transpose_tile_fits(ClRuntime& runtime, size_t tile)
+{
+    return group_fits(runtime, "transpose", tile, TRANSPOSE_TILE, TRANSPOSE_TILE,
+                      TRANSPOSE_TILE * (TRANSPOSE_TILE + 1) * sizeof(cl_float));
+}
+
+static void set_data(std::vector<float>& data, std::mt19937& generator)
+{
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+
+    for (float& value : data)
+    {
+        value = uniform(generator);
+    }
+}
+
+static void host_add(const std::vector<float>& a, const std::vector<float>& b, std::vector<float>& c)
+{
+    parallel_for(a.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            c[i] = a[i] + b[i];
+        }
+    });
+}
+
+static void host_transpose(const std::vector<float>& in, std::vector<float>& out, size_t n)
+{
+    parallel_for((n + HOST_BLOCK - 1) / HOST_BLOCK, [&](size_t first, size_t last)
+    {
+        for (size_t bi = first * HOST_BLOCK; bi < std::min(last * HOST_BLOCK, n); bi += HOST_BLOCK)
+        {
+            for (size_t bj = 0; bj < n; bj += HOST_BLOCK)
+            {
+                for (size_t i = bi; i < std::min(bi + HOST_BLOCK, n); ++i)
+                {
+                    for (size_t j = bj; j < std::min(bj + HOST_BLOCK, n); ++j)
+                    {
+                        out[j * n + i] = in[i * n + j];
+                    }
+                }
+            }
+        }
+    });
+}
+
+// c = a * b, threads own blocks of rows of c and walk a block by block in
+// i-k-j order so the innermost loop streams through rows of b and c
+static void host_gemm(const std::vector<float>& a, const std::vector<float>& b, std::vector<float>& c, size_t n)
+{
+    std::fill(c.begin(), c.end(), 0.f);
+
+    parallel_for((n + HOST_BLOCK - 1) / HOST_BLOCK, [&](size_t first, size_t last)
+    {
+        for (size_t bi = first * HOST_BLOCK; bi < std::min(last * HOST_BLOCK, n); bi += HOST_BLOCK)
+        {
+            for (size_t bk = 0; bk < n; bk += HOST_BLOCK)
+            {
+                for (size_t bj = 0; bj < n; bj += HOST_BLOCK)
+                {
+                    for (size_t i = bi; i < std::min(bi + HOST_BLOCK, n); ++i)
+                    {
+                        for (size_t k = bk; k < std::min(bk + HOST_BLOCK, n); ++k)
+                        {
+                            const float a_ik = a[i * n + k];
+
+                            for (size_t j = bj; j < std::min(bj + HOST_BLOCK, n); ++j)
+                            {
+                                c[i * n + j] += a_ik * b[k * n + j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
 
-static cl::Platform g_platform;
-static cl::Context  g_context;
-static cl::Device   g_device;
+// the device sums in a different order and with fused multiply-adds, so the
+// error allowed grows with the length of the dot products
+static bool verify(const std::vector<float>& expected, const std::vector<float>& actual, float tolerance)
+{
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        if (std::fabs(expected[i] - actual[i]) > tolerance * std::max(std::fabs(expected[i]), 1.f))
+        {
+            return false;
+        }
+    }
 
+    return true;
+}
 
-static void set_platform()
+static double best_kernel_seconds(cl::CommandQueue& queue,
+                                  cl::Kernel& kernel,
+                                  const cl::NDRange& global,
+                                  const cl::NDRange& local)
 {
-    cl_int status = CL_SUCCESS;
-    std::vector<cl::Platform> platforms;
+    double best_time = std::numeric_limits<double>::max();
 
-    status = cl::Platform::get(&platforms);
+    for (int iteration = 0; iteration < ITERATIONS; ++iteration)
+    {
+        cl::Event event;
+
+        queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local, NULL, &event);
+        event.wait();
 
-    if (status != CL_SUCCESS)
-        throw std::string("Failed to get available platforms");
+        best_time = std::min(best_time, elapsed_seconds(event));
+    }
 
-    g_platform = platforms.front();
+    return best_time;
 }
 
-static void set_device()
+static void print_result(const char* name, const OpResult& result, double flops, double bytes)
 {
-    cl_int status = CL_SUCCESS;
+    const double device = result.device_seconds;
+    const double host   = result.host_seconds;
 
-    status = clGetDeviceIDs(g_platform)
+    std::cout << std::setw(10) << name
+              << std::setw(12) << device * 1.0e3
+              << std::setw(12) << flops / device * 1.0e-9
+              << std::setw(12) << bytes / device * 1.0e-9
+              << std::setw(12) << host * 1.0e3
+              << std::setw(12) << flops / host * 1.0e-9
+              << std::setw(11) << host / device << "x"
+              << "  " << (result.passed ? GRN "PASS" RESET : RED "FAIL" RESET) << std::endl;
 }
 
+// add, transpose and GEMM of one matrix size
+static bool run_size(ClRuntime& runtime, size_t n, size_t tile, std::mt19937& generator)
+{
+    cl::CommandQueue& queue = runtime.queue();
+
+    const size_t count = n * n;
+
+    std::vector<float> a(count);
+    std::vector<float> b(count);
+    std::vector<float> device_c(count);
+    std::vector<float> host_c(count);
+
+    set_data(a, generator);
+    set_data(b, generator);
+
+    DeviceBuffer<cl_float> a_buffer(runtime.context(), count, CL_MEM_READ_ONLY);
+    DeviceBuffer<cl_float> b_buffer(runtime.context(), count, CL_MEM_READ_ONLY);
+    DeviceBuffer<cl_float> c_buffer(runtime.context(), count, CL_MEM_WRITE_ONLY);
+
+    a_buffer.write(queue, a.data());
+    b_buffer.write(queue, b.data());
+
+    const std::string options = kernel_options(tile);
+
+    std::cout << "\nn = " << n << "\n"
+              << std::setw(10) << "op"
+              << std::setw(12) << "device ms"
+              << std::setw(12) << "GFLOP/s"
+              << std::setw(12) << "GB/s"
+              << std::setw(12) << "host ms"
+              << std::setw(12) << "GFLOP/s"
+              << std::setw(12) << "speedup" << std::endl;
+
+    bool passed = true;
+
+    // element-wise add, four floats per work-item
+    {
+        cl::Kernel kernel = runtime.kernel(KERNEL_FILE, "matrix_add", options);
+        kernel.setArg(0, a_buffer.get());
+        kernel.setArg(1, b_buffer.get());
+        kernel.setArg(2, c_buffer.get());
+        kernel.setArg(3, static_cast<cl_uint>(count / 4));
+
+        OpResult result;
+        result.device_seconds = best_kernel_seconds(queue, kernel, cl::NDRange(count / 4), cl::NullRange);
+        result.host_seconds   = best_seconds(ITERATIONS, [&]() { host_add(a, b, host_c); });
+
+        c_buffer.read(queue, device_c.data());
+        result.passed = verify(host_c, device_c, 0.f);
+        passed = passed && result.passed;
+
+        print_result("add", result, double(count), 12.0 * count);
+    }
+
+    // transpose through local memory tiles
+    {
+        cl::Kernel kernel = runtime.kernel(KERNEL_FILE, "transpose", options);
+        kernel.setArg(0, a_buffer.get());
+        kernel.setArg(1, c_buffer.get());
+        kernel.setArg(2, static_cast<cl_uint>(n));
+
+        OpResult result;
+        result.device_seconds = best_kernel_seconds(queue, kernel, cl::NDRange(n, n), cl::NDRange(TRANSPOSE_TILE, TRANSPOSE_TILE));
+        result.host_seconds   = best_seconds(ITERATIONS, [&]() { host_transpose(a, host_c, n); });
 
-int main()
+        c_buffer.read(queue, device_c.data());
+        result.passed = verify(host_c, device_c, 0.f);
+        passed = passed && result.passed;
+
+        // moves data only, the GFLOP/s columns stay at zero
+        print_result("transpose", result, 0.0, 8.0 * count);
+    }
+
+    // tiled GEMM, every work-item computes a float4 of c
+    {
+        cl::Kernel kernel = runtime.kernel(KERNEL_FILE, "gemm", options);
+        kernel.setArg(0, a_buffer.get());
+        kernel.setArg(1, b_buffer.get());
+        kernel.setArg(2, c_buffer.get());
+        kernel.setArg(3, static_cast<cl_uint>(n));
+
+        OpResult result;
+        result.device_seconds = best_kernel_seconds(queue, kernel, cl::NDRange(n / 4, n), cl::NDRange(tile / 4, tile));
+        result.host_seconds   = best_seconds(ITERATIONS, [&]() { host_gemm(a, b, host_c, n); });
+
+        c_buffer.read(queue, device_c.data());
+        result.passed = verify(host_c, device_c, 1.e-3f);
+        passed = passed && result.passed;
+
+        // compulsory traffic: a and b read once and c written once
+        print_result("gemm", result, 2.0 * n * n * n, 12.0 * count);
+    }
+
+    return passed;
+}
+
+
+int main(int argc, char* argv[])
 {
     try
     {
-        set_platform();
+        ClRuntime runtime(DeviceQuery::from_args(argc, argv));
+        print_device_info(std::cout, runtime.device());
 
-        std::cout << "Platform name: "   << g_platform.getInfo<CL_PLATFORM_NAME>() << std::endl;
-        std::cout << "Platform vendor: " << g_platform.getInfo<CL_PLATFORM_VENDOR>() << std::endl;
+        size_t tile = gemm_tile(argc, argv);
+
+        // halve the tile until its work-group and local memory fit the device
+        // and the compiled kernel. halving keeps it a multiple of 4 for the
+        // kernel's float4 loads.
+        while (!gemm_tile_fits(runtime, tile))
+        {
+            if (tile == 4)
+            {
+                throw ClRuntimeError("the device has no room for a GEMM tile, not even 4 x 4");
+            }
+
+            tile = std::max<size_t>(tile / 2 / 4 * 4, 4);
+        }
+
+        if (!transpose_tile_fits(runtime, tile))
+        {
+            throw ClRuntimeError("the device has no room for the " + std::to_string(TRANSPOSE_TILE) + " x " +
+                                 std::to_string(TRANSPOSE_TILE) + " transpose tile");
+        }
+
+        std::cout << "\nGEMM tile : " << tile << " x " << tile << std::endl;
+
+        std::mt19937 generator(std::random_device{}());
+
+        bool   passed = true;
+        size_t ran    = 0;
+
+        for (size_t n : MATRIX_SIZES)
+        {
+            if (n % tile != 0 || n % TRANSPOSE_TILE != 0)
+            {
+                std::cout << "\nn = " << n << " skipped, not a multiple of the tiles" << std::endl;
+                continue;
+            }
+
+            passed = run_size(runtime, n, tile, generator) && passed;
+            ++ran;
+        }
+
+        // a tile that skips every size verified nothing
+        if (ran == 0)
+        {
+            std::cerr << RED "\nno matrix size is a multiple of both the GEMM tile " << tile
+                          << " and the transpose tile " << TRANSPOSE_TILE << RESET << std::endl;
+            passed = false;
+        }
+
+        std::cerr << "\nVerification result : " << (passed ? "PASS" : "FAIL") << std::endl;
+
+        if (!passed)
+        {
+            return EXIT_FAILURE;
+        }
     }
-    catch(cl::Error& e)
+    catch (cl::Error& e)
     {
-        std::cerr << "ERROR: " << "Program failed" << std::endl;
+        std::cerr << RED "OpenCL error: " << e.what() << " (" << e.err() << ")" RESET << std::endl;
+        return EXIT_FAILURE;
     }
-    catch(std::string e)
+    catch (std::exception& e)
     {
-        std::cerr << "ERROR: " << e << std::endl;
+        std::cerr << RED << e.what() << RESET << std::endl;
+        return EXIT_FAILURE;
     }
 
     return 0;
-}
\ No newline at end of file
+}
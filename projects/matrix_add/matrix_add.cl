@@ -0,0 +1,96 @@
+// dense row-major n x n float matrices. the host sets
+//   TILE            GEMM tile edge, a multiple of 4 (default 16)
+//   TRANSPOSE_TILE  transpose tile edge (default 16)
+// and launches with n a multiple of both.
+
+#ifndef TILE
+#define TILE 16
+#endif
+
+#ifndef TRANSPOSE_TILE
+#define TRANSPOSE_TILE 16
+#endif
+
+// c = a + b, four elements per work-item
+__kernel void matrix_add(__global const float4* a,
+                         __global const float4* b,
+                         __global float4* c,
+                         uint count4)
+{
+    const uint i = get_global_id(0);
+
+    if (i < count4)
+    {
+        c[i] = a[i] + b[i];
+    }
+}
+
+// out = transpose(in). a work-group reads a tile row by row and writes it
+// back row by row at the mirrored position, so both global accesses are
+// coalesced; the padding column keeps the column reads of the local tile
+// free of bank conflicts.
+__kernel __attribute__((reqd_work_group_size(TRANSPOSE_TILE, TRANSPOSE_TILE, 1)))
+void transpose(__global const float* in,
+               __global float* out,
+               uint n)
+{
+    __local float tile[TRANSPOSE_TILE][TRANSPOSE_TILE + 1];
+
+    const uint lx = get_local_id(0);
+    const uint ly = get_local_id(1);
+
+    tile[ly][lx] = in[get_global_id(1) * n + get_global_id(0)];
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    const uint out_x = get_group_id(1) * TRANSPOSE_TILE + lx;
+    const uint out_y = get_group_id(0) * TRANSPOSE_TILE + ly;
+
+    out[out_y * n + out_x] = tile[lx][ly];
+}
+
+// c = a * b with TILE x TILE tiles of a and b staged in local memory. a
+// work-item computes four adjacent elements of a row of c, so the
+// work-group is TILE / 4 x TILE and every global load is a float4.
+__kernel __attribute__((reqd_work_group_size(TILE / 4, TILE, 1)))
+void gemm(__global const float4* a,
+          __global const float4* b,
+          __global float4* c,
+          uint n)
+{
+    __local float4 a_tile[TILE][TILE / 4];
+    __local float4 b_tile[TILE][TILE / 4];
+
+    const uint col4 = get_local_id(0);
+    const uint row  = get_local_id(1);
+
+    const uint global_col4 = get_global_id(0);
+    const uint global_row  = get_global_id(1);
+
+    const uint n4 = n / 4;
+
+    float4 acc = (float4)(0.0f);
+
+    for (uint t = 0; t < n / TILE; ++t)
+    {
+        // a[global_row][t * TILE ...] and b[t * TILE + row][global_col4 * 4 ...]
+        a_tile[row][col4] = a[global_row * n4 + t * (TILE / 4) + col4];
+        b_tile[row][col4] = b[(t * TILE + row) * n4 + global_col4];
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (uint k4 = 0; k4 < TILE / 4; ++k4)
+        {
+            const float4 a4 = a_tile[row][k4];
+
+            acc = fma((float4)(a4.x), b_tile[4 * k4][col4], acc);
+            acc = fma((float4)(a4.y), b_tile[4 * k4 + 1][col4], acc);
+            acc = fma((float4)(a4.z), b_tile[4 * k4 + 2][col4], acc);
+            acc = fma((float4)(a4.w), b_tile[4 * k4 + 3][col4], acc);
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    c[global_row * n4 + global_col4] = acc;
+}
@@ -0,0 +1,171 @@
+#include "ParticleCompute.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+static const std::size_t WORK_GROUP_SIZE = 64;
+
+// first device of the requested type on any platform
+static DeviceQuery device_query(cl_device_type device_type)
+{
+    DeviceQuery query;
+    query.types = {device_type};
+    return query;
+}
+
+ParticleCompute::ParticleCompute(const std::string& kernel_file,
+                                 cl_device_type device_type,
+                                 std::uint64_t seed)
+: m_runtime(device_query(device_type)),
+  m_bound(),
+  m_capacity(0),
+  m_mapped(false),
+  m_seed(seed),
+  m_frame(0),
+  m_kernel_time(0.0)
+{
+    m_kernel = m_runtime.kernel(kernel_file, "integrate_particles", "-cl-std=CL1.2");
+}
+
+ParticleCompute::~ParticleCompute()
+{
+    // hand the store back to the host for good
+    try
+    {
+        unmap();
+        m_runtime.finish();
+    }
+    catch (cl::Error& e)
+    {
+        std::cerr << "ParticleCompute: " << e.what() << " (" << e.err() << ")" << std::endl;
+    }
+}
+
+std::string ParticleCompute::device_name() const
+{
+    return m_runtime.device_name();
+}
+
+double ParticleCompute::kernel_time() const
+{
+    return m_kernel_time;
+}
+
+void ParticleCompute::bind(ParticleStore& store)
+{
+    const void* arrays[4] = {store.position.data(), store.velocity.data(), store.lifetime.data(), store.color.data()};
+
+    if (store.size() == m_capacity && std::equal(arrays, arrays + 4, m_bound))
+    {
+        return;
+    }
+
+    unmap();
+
+    const std::size_t count = store.size();
+    const cl_mem_flags flags = CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR;
+
+    m_position = cl::Buffer(m_runtime.context(), flags, count * sizeof(sf::Vector2f), store.position.data());
+    m_velocity = cl::Buffer(m_runtime.context(), flags, count * sizeof(sf::Vector2f), store.velocity.data());
+    m_lifetime = cl::Buffer(m_runtime.context(), flags, count * sizeof(float), store.lifetime.data());
+    m_color    = cl::Buffer(m_runtime.context(), flags, count * sizeof(sf::Color), store.color.data());
+
+    std::copy(arrays, arrays + 4, m_bound);
+    m_capacity = count;
+
+    m_kernel.setArg(0, m_position);
+    m_kernel.setArg(1, m_velocity);
+    m_kernel.setArg(2, m_lifetime);
+    m_kernel.setArg(3, m_color);
+
+    // a new buffer belongs to the host until the first kernel runs
+    map();
+}
+
+void ParticleCompute::map()
+{
+    if (m_mapped)
+    {
+        return;
+    }
+
+    // for USE_HOST_PTR buffers a map returns the store's own pointer and
+    // guarantees it holds the latest data
+    const cl_map_flags flags = CL_MAP_READ | CL_MAP_WRITE;
+    cl::CommandQueue&  queue = m_runtime.queue();
+
+    queue.enqueueMapBuffer(m_position, CL_FALSE, flags, 0, m_capacity * sizeof(sf::Vector2f));
+    queue.enqueueMapBuffer(m_velocity, CL_FALSE, flags, 0, m_capacity * sizeof(sf::Vector2f));
+    queue.enqueueMapBuffer(m_lifetime, CL_FALSE, flags, 0, m_capacity * sizeof(float));
+    queue.enqueueMapBuffer(m_color,    CL_FALSE, flags, 0, m_capacity * sizeof(sf::Color));
+    queue.finish();
+
+    m_mapped = true;
+}
+
+void ParticleCompute::unmap()
+{
+    if (!m_mapped)
+    {
+        return;
+    }
+
+    cl::CommandQueue& queue = m_runtime.queue();
+
+    queue.enqueueUnmapMemObject(m_position, const_cast<void*>(m_bound[0]));
+    queue.enqueueUnmapMemObject(m_velocity, const_cast<void*>(m_bound[1]));
+    queue.enqueueUnmapMemObject(m_lifetime, const_cast<void*>(m_bound[2]));
+    queue.enqueueUnmapMemObject(m_color,    const_cast<void*>(m_bound[3]));
+
+    m_mapped = false;
+}
+
+void ParticleCompute::integrate(ParticleStore& store, float dt, const SpawnParams& spawn)
+{
+    static_assert(sizeof(sf::Vector2f) == sizeof(cl_float2), "positions are processed as float2");
+    static_assert(sizeof(sf::Color) == sizeof(cl_uint), "colours are processed as packed RGBA words");
+
+    if (store.live == 0)
+    {
+        return;
+    }
+
+    bind(store);
+
+    cl_float2 emitter;
+    emitter.s[0] = spawn.emitter.x;
+    emitter.s[1] = spawn.emitter.y;
+
+    cl_float4 params;
+    params.s[0] = spawn.speed_min;
+    params.s[1] = spawn.speed_max - spawn.speed_min;
+    params.s[2] = spawn.lifetime_min;
+    params.s[3] = spawn.lifetime_max - spawn.lifetime_min;
+
+    m_kernel.setArg(4, static_cast<cl_uint>(store.live));
+    m_kernel.setArg(5, dt);
+    m_kernel.setArg(6, spawn.inv_lifetime);
+    m_kernel.setArg(7, emitter);
+    m_kernel.setArg(8, params);
+    m_kernel.setArg(9, static_cast<cl_ulong>(m_seed));
+    m_kernel.setArg(10, static_cast<cl_ulong>(m_frame));
+
+    const std::size_t global_size = (store.live + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE * WORK_GROUP_SIZE;
+
+    // the host writes made while mapped reach the device on unmap
+    unmap();
+
+    cl::Event event;
+    m_runtime.queue().enqueueNDRangeKernel(m_kernel,
+                                           cl::NullRange,
+                                           cl::NDRange(global_size),
+                                           cl::NDRange(WORK_GROUP_SIZE),
+                                           nullptr,
+                                           &event);
+    map();
+
+    m_kernel_time = elapsed_seconds(event);
+
+    ++m_frame;
+}
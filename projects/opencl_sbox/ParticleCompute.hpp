@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "ClRuntime.hpp"
+#include "ParticleIntegrator.hpp"
+
+// OpenCL backend for the particle classes: runs integrate_particles from
+// kernel_file.cl over a ParticleStore. the buffers wrap the store's own
+// arrays (CL_MEM_USE_HOST_PTR), so a CPU runtime such as PoCL works on them
+// in place and a GPU runtime copies only on map and unmap.
+class ParticleCompute : public ParticleIntegrator
+{
+public:
+    // uses the first device of the given type on any platform. respawns
+    // are reproducible for a given seed. throws cl::Error or
+    // ClRuntimeError when no device is found or the kernel does not build.
+    explicit ParticleCompute(const std::string& kernel_file = "kernel_file.cl",
+                             cl_device_type device_type = CL_DEVICE_TYPE_ALL,
+                             std::uint64_t seed = 0);
+
+    virtual ~ParticleCompute();
+
+    virtual void integrate(ParticleStore& store, float dt, const SpawnParams& spawn);
+
+    std::string device_name() const;
+
+    // device time of the last integrate() call in seconds
+    double kernel_time() const;
+
+private:
+    void bind(ParticleStore& store);
+    void map();
+    void unmap();
+
+    ClRuntime  m_runtime;
+    cl::Kernel m_kernel;
+
+    // the buffers are rebuilt only when the store's arrays move or resize;
+    // between calls they stay mapped so the host can read and write the store
+    cl::Buffer  m_position;
+    cl::Buffer  m_velocity;
+    cl::Buffer  m_lifetime;
+    cl::Buffer  m_color;
+    const void* m_bound[4];
+    std::size_t m_capacity;
+    bool        m_mapped;
+
+    std::uint64_t m_seed;
+    std::uint64_t m_frame;
+    double        m_kernel_time;
+};
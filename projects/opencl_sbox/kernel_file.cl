@@ -1,3 +1,86 @@
+// particles each work-item advances, set by the host's tuned launch
+#ifndef ITEMS_PER_WORK_ITEM
+#define ITEMS_PER_WORK_ITEM 1
+#endif
+
+// splitmix64, the same hash as ParticleRandom on the host
+#define GOLDEN_GAMMA 0x9e3779b97f4a7c15UL
+
+ulong splitmix(ulong z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+    return z ^ (z >> 31);
+}
+
+// number n of the stream with the given key, uniform in [0, 1)
+float uniform_float(ulong key, ulong n)
+{
+    return (float)(splitmix(key + n * GOLDEN_GAMMA) >> 40) * (1.0f / 16777216.0f);
+}
+
+// advances ITEMS_PER_WORK_ITEM particles per work-item by dt; a particle whose
+// lifetime runs out restarts at the emitter. particle i draws from its own stream, the same
+// one as ParticleRandom(seed, i) on the host, and a respawn in frame f uses
+// numbers 3f + 1 to 3f + 3, so results do not depend on the work-group layout.
+// spawn = (speed min, speed range, lifetime min, lifetime range)
+__kernel void integrate_particles(__global float2* position,
+                                  __global float2* velocity,
+                                  __global float* lifetime,
+                                  __global uint* color,
+                                  const uint count,
+                                  const float dt,
+                                  const float inv_lifetime,
+                                  const float2 emitter,
+                                  const float4 spawn,
+                                  const ulong seed,
+                                  const ulong frame)
+{
+    // a work-group covers ITEMS_PER_WORK_ITEM consecutive blocks of its size,
+    // so neighbouring work-items still touch neighbouring particles. the
+    // global offset of a pipelined slice is added once.
+    const size_t local_size = get_local_size(0);
+    const size_t first      = get_global_offset(0) + get_group_id(0) * local_size * ITEMS_PER_WORK_ITEM + get_local_id(0);
+
+    for (uint k = 0; k < ITEMS_PER_WORK_ITEM; ++k)
+    {
+        size_t i = first + k * local_size;
+
+        // the global size is rounded up to whole work-groups
+        if (i >= count)
+        {
+            return;
+        }
+
+        float  life = lifetime[i] - dt;
+        float2 pos  = position[i];
+
+        if (life <= 0.0f)
+        {
+            ulong key = splitmix(seed ^ splitmix(i + GOLDEN_GAMMA));
+            ulong n   = frame * 3;
+
+            float angle = uniform_float(key, n + 1) * 6.28318531f;
+            float speed = spawn.x + spawn.y * uniform_float(key, n + 2);
+            life        = spawn.z + spawn.w * uniform_float(key, n + 3);
+
+            velocity[i] = (float2)(cos(angle), sin(angle)) * speed;
+            pos         = emitter;
+        }
+        else
+        {
+            pos += velocity[i] * dt;
+        }
+
+        position[i] = pos;
+        lifetime[i] = life;
+
+        // alpha is the top byte of the packed RGBA colour
+        float alpha = clamp(life * inv_lifetime * 255.0f, 0.0f, 255.0f);
+        color[i]    = (color[i] & 0x00FFFFFFu) | ((uint)alpha << 24);
+    }
+}
+
 __kernel void test_kernel(__global float2* in_buffer,
                           __global float2* out_buffer,
                           __local float2* local_cache)
@@ -1,19 +1,29 @@
-#define CL_HPP_ENABLE_EXCEPTIONS
-#define CL_HPP_TARGET_OPENCL_VERSION 210
+#include "BufferStrategy.hpp"
+#include "ClRuntime.hpp"
+#include "EventRecorder.hpp"
+#include "HostBaseline.hpp"
+#include "KernelTuner.hpp"
 
-#include <CL/opencl.hpp>
 #include <iostream>
 #include <vector>
+#include <chrono>
 #include <string>
 #include <cstdlib>
 #include <random>
-#include <fstream>
+#include <algorithm>
+#include <iomanip>
 #include <limits>   //std::numeric_limits
 #include <cmath>    //std::fabs
 #include <locale>   //std::locale, std::numpunct, std::use_facet
 
+// the host reference draws its respawns from the same streams as the kernel,
+// the optimized baseline advances the particles with the particle classes' kernel
+#include "ParticleKernels.hpp"
+#include "ParticleRandom.hpp"
+
 using real  = cl_float;
 using real2 = cl_float2;
+using real4 = cl_float4;
 
 struct space_out : std::numpunct<char>
 {
@@ -28,468 +38,783 @@ struct space_out : std::numpunct<char>
     }
 };
 
-static cl_device_type g_device_type = CL_DEVICE_TYPE_GPU;
-const  size_t g_block_size = 256u;
+// launch shape of the kernel, the tuned one for this device when there is one
+static KernelConfig g_config;
+
+static cl::Kernel g_kernel;
+
+static cl_uint  g_num_particles = 60 * 256 * 256;
+static cl_uint  g_num_steps     = 60;
+static real     g_dt            = 1.f / 60.f;
+static real     g_inv_lifetime  = 1.f / 3.f;
+static cl_ulong g_seed          = 0;
+
+// the pipelined run splits the particles into slices that flow through an
+// upload, a compute and a download queue, so transfers overlap the kernels
+static cl_uint      g_num_slices = 4;
+static const size_t g_num_queues = 3;
 
-static cl::Platform     g_platform;
-static cl::Context      g_context;
-static cl::Device       g_device;
-static cl::CommandQueue g_command_queue;
-static cl::Buffer       g_input_buffer;
-static cl::Buffer       g_output_buffer;
-static cl::Program      g_program;
-static cl::Kernel       g_kernel;
+// respawns restart at the emitter with speed (min, range) and lifetime (min, range)
+static const real2 g_emitter = {{960.f, 540.f}};
+static const real4 g_spawn   = {{50.f, 50.f, 1.f, 2.f}};
 
-static cl_uint g_num_particles = 60 * 256 * 256;
-static real*   g_particles     = nullptr;
-static real*   g_out_particles = nullptr;
-static real*   g_pin_particles = nullptr;
+// the starting state, every buffer mode runs from the same particles
+static std::vector<real2>   g_init_positions(g_num_particles);
+static std::vector<real2>   g_init_velocities(g_num_particles);
+static std::vector<real>    g_init_lifetimes(g_num_particles);
+static std::vector<cl_uint> g_init_colors(g_num_particles);
 
-static std::vector<real2> g_host_particles(g_num_particles);
+// the same particles advanced on the host for verification
+static std::vector<real2>   g_host_positions(g_num_particles);
+static std::vector<real2>   g_host_velocities(g_num_particles);
+static std::vector<real>    g_host_lifetimes(g_num_particles);
+static std::vector<cl_uint> g_host_colors(g_num_particles);
 
-static cl::Buffer g_particles_buf;
-static cl::Buffer g_pinned_output_buf;
+// the optimized host baseline advances the particles in blocks that stay in
+// the cache for all steps
+static const size_t g_host_block = 4096u;
+
+// the particle arrays shared with the device in one buffer mode
+struct DeviceParticles
+{
+    SharedArray<real2>   positions;
+    SharedArray<real2>   velocities;
+    SharedArray<real>    lifetimes;
+    SharedArray<cl_uint> colors;
+
+    DeviceParticles(ClRuntime& runtime, BufferMode mode)
+    : positions(runtime, mode, g_num_particles),
+      velocities(runtime, mode, g_num_particles),
+      lifetimes(runtime, mode, g_num_particles),
+      colors(runtime, mode, g_num_particles)
+    {}
+
+    void set_args(cl::Kernel& kernel) const
+    {
+        positions.set_arg(kernel, 0);
+        velocities.set_arg(kernel, 1);
+        lifetimes.set_arg(kernel, 2);
+        colors.set_arg(kernel, 3);
+    }
+
+    void to_device(std::vector<cl::Event>& events)
+    {
+        positions.to_device(events);
+        velocities.to_device(events);
+        lifetimes.to_device(events);
+        colors.to_device(events);
+    }
+
+    void to_host(std::vector<cl::Event>& events)
+    {
+        positions.to_host(events);
+        velocities.to_host(events);
+        lifetimes.to_host(events);
+        colors.to_host(events);
+    }
+};
 
 static std::string g_kernel_file("kernel_file.cl");
-static std::string g_kernel_name("test_kernel");
+static std::string g_kernel_name("integrate_particles");
 
 static bool is_close(real a, real b)
 {
-    // return std::fabs(a - b) < std::numeric_limits<T>::epsilon();
-    return std::fabs(a - b) < std::numeric_limits<real>::epsilon();
+    // the device may fuse a * b + c and its cos/sin are not correctly
+    // rounded, so results are compared with a relative tolerance
+    const real tolerance = 1.e-4f;
+    return std::fabs(a - b) <= tolerance * std::max(std::fabs(a), std::fabs(b)) + std::numeric_limits<real>::epsilon();
 }
 
-static void set_platform(void)
+
+static void set_data(void)
 {
-    cl_int status = CL_SUCCESS;
-    std::vector<cl::Platform> platforms;
+    std::random_device rd;
+    static std::uniform_real_distribution<real> xdis(0, 1920);
+    static std::uniform_real_distribution<real> ydis(0, 1080);
+    static std::uniform_real_distribution<real> vdis(-100, 100);
+    static std::uniform_real_distribution<real> ldis(0, 3);
+    static std::default_random_engine generator(rd());
 
-    try
+    // red, green and blue with full alpha, packed as RGBA bytes
+    const cl_uint colors[] = {0xFF0000FFu, 0xFF00FF00u, 0xFFFF0000u};
+
+    // lifetimes spread over the run so that particles die and respawn on every step
+    for (cl_uint i = 0; i < g_num_particles; ++i)
     {
-        status = cl::Platform::get(&platforms);
+        g_init_positions[i]  = {{xdis(generator), ydis(generator)}};
+        g_init_velocities[i] = {{vdis(generator), vdis(generator)}};
+        g_init_lifetimes[i]  = ldis(generator);
+        g_init_colors[i]     = colors[i % 3];
+    }
 
-        if (platforms.size() > 0)
-        {
-            std::cout << "Found " << platforms.size() << " platforms" << std::endl;
-            g_platform = platforms.front();
+    g_host_positions  = g_init_positions;
+    g_host_velocities = g_init_velocities;
+    g_host_lifetimes  = g_init_lifetimes;
+    g_host_colors     = g_init_colors;
+}
 
-            std::cout << "Platform name: "   << g_platform.getInfo<CL_PLATFORM_NAME>() << std::endl;
-            std::cout << "Platform vendor: " << g_platform.getInfo<CL_PLATFORM_VENDOR>() << std::endl;
-        }
 
-    }
-    catch(cl::Error& e)
-    {
-        std::cout << "set_platform() failed (" << status << ") : " << e.what() << std::endl;
-        exit(EXIT_FAILURE);
-    }
+static std::string build_options(const KernelConfig& config)
+{
+    return "-cl-std=CL1.2" + config.build_options();
 }
 
-static void set_context(void)
+// the kernel built for one launch shape, with every argument but the
+// particle arrays 0 to 3 and the step set
+static cl::Kernel build_kernel(ClRuntime& runtime, const KernelConfig& config)
 {
-    cl_int status = CL_SUCCESS;
+    cl::Kernel kernel = runtime.kernel(g_kernel_file, g_kernel_name, build_options(config));
 
-    try
-    {
-        cl_context_properties cprops[3] = 
-        {
-            CL_CONTEXT_PLATFORM,
-            (cl_context_properties)(g_platform)(),
-            0
-        };
+    kernel.setArg(4, g_num_particles);
+    kernel.setArg(5, g_dt);
+    kernel.setArg(6, g_inv_lifetime);
+    kernel.setArg(7, g_emitter);
+    kernel.setArg(8, g_spawn);
+    kernel.setArg(9, g_seed);
 
-        g_context = cl::Context(g_device_type, cprops, NULL, NULL, &status);
+    return kernel;
+}
 
-    }
-    catch(cl::Error& e)
-    {
-        std::cout << "set_context() failed (" << status << ") : " << e.what() << std::endl;
-        exit(EXIT_FAILURE);
-    }
+static void create_kernel(ClRuntime& runtime)
+{
+    // the first run compiles the kernel, later runs load the cached binary
+    auto start = std::chrono::steady_clock::now();
+    g_kernel = build_kernel(runtime, g_config);
+    std::chrono::duration<double> build_time = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Program build: " << build_time.count() << " s ("
+              << (runtime.programs().loaded_from_binary(g_kernel_file, build_options(g_config)) ? "cached binary" : "compiled")
+              << ")" << std::endl;
 }
 
-static void set_device()
+// the stored launch shape for this device; with `sweep` every shape is timed
+// over a few steps first and the fastest one is stored for later runs
+static KernelConfig tuned_config(ClRuntime& runtime, bool sweep)
 {
-    cl_int status = CL_SUCCESS;
-    std::vector<cl::Device> devices;
+    const cl_uint tune_steps = 10;
 
-    try
+    KernelTuner tuner(runtime);
+
+    // the particles are only uploaded when the tuner runs the kernel
+    DeviceBuffer<real2>   positions;
+    DeviceBuffer<real2>   velocities;
+    DeviceBuffer<real>    lifetimes;
+    DeviceBuffer<cl_uint> colors;
+
+    if (sweep)
     {
-        devices = g_context.getInfo<CL_CONTEXT_DEVICES>();
+        positions  = DeviceBuffer<real2>(runtime.context(), g_num_particles);
+        velocities = DeviceBuffer<real2>(runtime.context(), g_num_particles);
+        lifetimes  = DeviceBuffer<real>(runtime.context(), g_num_particles);
+        colors     = DeviceBuffer<cl_uint>(runtime.context(), g_num_particles);
+
+        positions.write(runtime.queue(), g_init_positions.data());
+        velocities.write(runtime.queue(), g_init_velocities.data());
+        lifetimes.write(runtime.queue(), g_init_lifetimes.data());
+        colors.write(runtime.queue(), g_init_colors.data());
+    }
 
-        size_t num_devices = devices.size();
+    // every particle is independent, so only the launch shape is swept
+    TuneSpace space;
+    space.items_per_work_item = {1, 2, 4, 8};
 
-        if (num_devices <= 0)
-        {
-            std::cerr << "No device available" << std::endl;
-            exit(EXIT_FAILURE);
-        }
-        else
+    const KernelConfig fallback;
+
+    tuner.add_kernel(g_kernel_name, build_kernel(runtime, fallback), space, fallback, [&](const KernelConfig& config)
+    {
+        cl::Kernel kernel = build_kernel(runtime, config);
+
+        kernel.setArg(0, positions.get());
+        kernel.setArg(1, velocities.get());
+        kernel.setArg(2, lifetimes.get());
+        kernel.setArg(3, colors.get());
+
+        std::vector<cl::Event> events(tune_steps);
+
+        for (cl_uint step = 0; step < tune_steps; ++step)
         {
-            std::cout << "Found " << num_devices << " device(s)" << std::endl;
+            kernel.setArg(10, static_cast<cl_ulong>(step));
+
+            runtime.queue().enqueueNDRangeKernel(kernel,
+                                                 cl::NullRange,
+                                                 cl::NDRange(config.global_size(g_num_particles)),
+                                                 cl::NDRange(config.local_size),
+                                                 NULL,
+                                                 &events[step]);
         }
 
-        std::vector<cl::Device>::iterator itr;
+        runtime.queue().finish();
 
-        for(itr = devices.begin(); itr != devices.end(); ++itr)
-        {
-#ifdef CL_DEVICE_BOARD_NAME_AMD
-            std::string device_name;
+        return total_seconds(events);
+    });
+
+    if (sweep)
+    {
+        tuner.tune(std::cout);
+    }
 
-            (*itr).getInfo<std::string>(CL_DEVICE_BOARD_NAME_AMD, &device_name);
+    const KernelConfig config = tuner.config(g_kernel_name);
 
-            std::cout << "Device name       : " << device_name << std::endl;
-#else
-            std::cout << "Device name       : " << (*itr).getInfo<CL_DEVICE_NAME>() << std::endl;
-#endif
+    std::cout << "Launch: " << config
+              << (tuner.is_tuned(g_kernel_name) ? " (tuned)" : " (default, --tune sweeps)") << std::endl;
 
-            std::cout << "Device type       : " << (*itr).getInfo<CL_DEVICE_TYPE>() << std::endl;
-            std::cout << "Device profile    : " << (*itr).getInfo<CL_DEVICE_PROFILE>() << std::endl;
-            std::cout << "Device vendor ID  : " << (*itr).getInfo<CL_DEVICE_VENDOR_ID>() << std::endl;
-            std::cout << "Max compute units : " << (*itr).getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() << std::endl;
-            std::cout << "Max Work group    : " << (*itr).getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() << std::endl;
+    return config;
+}
 
-            std::cout << "Max WI dims       : " << (*itr).getInfo<CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS>() << std::endl;
+static bool verify_results(const real2* positions,
+                           const real2* velocities,
+                           const real* lifetimes,
+                           const cl_uint* colors);
 
-            std::vector<size_t> wi_dims = (*itr).getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+// runs every step on particles shared in `mode` and prints one row of the report:
+// upload before the first step, kernel time of all steps, download after the last
+static double run_kernel(ClRuntime& runtime, BufferMode mode, EventRecorder& recorder)
+{
+    DeviceParticles particles(runtime, mode);
 
-            for (size_t i = 0; i < wi_dims.size(); ++i)
-            {
-                std::cout << "   Dim[" << i << "]: " << wi_dims[i] << std::endl;
-            }
+    std::copy(g_init_positions.begin(), g_init_positions.end(), particles.positions.begin());
+    std::copy(g_init_velocities.begin(), g_init_velocities.end(), particles.velocities.begin());
+    std::copy(g_init_lifetimes.begin(), g_init_lifetimes.end(), particles.lifetimes.begin());
+    std::copy(g_init_colors.begin(), g_init_colors.end(), particles.colors.begin());
 
-            cl_device_svm_capabilities svm = (*itr).getInfo<CL_DEVICE_SVM_CAPABILITIES>();
-            std::cout << "Device SVM coarse grain : " << ( (svm & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER) ? "Yes" : "No") << std::endl;
-            std::cout << "Device SVM fine grain buffer : " << ( (svm & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) ? "Yes" : "No") << std::endl;
-            std::cout << "Device SVM fine grain system : " << ( (svm & CL_DEVICE_SVM_FINE_GRAIN_SYSTEM) ? "Yes" : "No") << std::endl;
-            std::cout << "Device SVM atomics : " << ( (svm & CL_DEVICE_SVM_ATOMICS) ? "Yes" : "No") << std::endl;
+    std::vector<cl::Event> upload_events;
+    std::vector<cl::Event> kernel_events(g_num_steps);
+    std::vector<cl::Event> download_events;
 
-            if ((*itr).getInfo<CL_DEVICE_TYPE>() == g_device_type)
-            {
-                std::cout << "Found matching device type" << std::endl;
-                g_device = *itr;
-            }
+    // round up to whole work-groups, the kernel skips the padding
+    const size_t global_size = g_config.global_size(g_num_particles);
 
-            std::cout << std::endl;
-        }
-    }
-    catch(cl::Error& e)
+    particles.to_device(upload_events);
+    particles.set_args(g_kernel);
+
+    for (cl_uint step = 0; step < g_num_steps; ++step)
     {
-        std::cout << "set_device() failed (" << status << ") : " << e.what() << std::endl;
-        exit(EXIT_FAILURE);
-    }
-}
+        g_kernel.setArg(10, static_cast<cl_ulong>(step));
 
-/**
-// static void set_default_device(void)
-// {
-//     g_device = cl::Device::getDefault();
+        runtime.queue().enqueueNDRangeKernel(g_kernel,
+                                             cl::NullRange,
+                                             cl::NDRange(global_size),
+                                             cl::NDRange(g_config.local_size),
+                                             NULL,
+                                             &kernel_events[step]);
+    }
 
-//     std::cout << "Device name       : " << g_device.getInfo<CL_DEVICE_NAME>() << std::endl;
-//     std::cout << "Device profile    : " << g_device.getInfo<CL_DEVICE_PROFILE>() << std::endl;
-//     std::cout << "Device vendor ID  : " << g_device.getInfo<CL_DEVICE_VENDOR_ID>() << std::endl;
-//     std::cout << "Max compute units : " << g_device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() << std::endl;
-//     std::cout << "Max Work group    : " << g_device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() << std::endl;
+    // the host arrays hold the latest data again after this
+    particles.to_host(download_events);
+    runtime.finish();
 
-//     std::cout << "Max WI dims       : " << g_device.getInfo<CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS>() << std::endl;
+    recorder.record(upload_events, "upload", 0, to_string(mode));
+    recorder.record(kernel_events, g_kernel_name, 0, to_string(mode));
+    recorder.record(download_events, "download", 0, to_string(mode));
 
-//     std::vector<size_t> wi_dims = g_device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+    const double upload_time   = total_seconds(upload_events);
+    const double kernel_time   = total_seconds(kernel_events);
+    const double download_time = total_seconds(download_events);
 
-//     for (size_t i = 0; i < wi_dims.size(); ++i)
-//     {
-//         std::cout << "   Dim[" << i << "]: " << wi_dims[i] << std::endl;
-//     }
-// }
-*/
+    const bool passed = verify_results(particles.positions.data(),
+                                       particles.velocities.data(),
+                                       particles.lifetimes.data(),
+                                       particles.colors.data());
 
-static void set_command_queue(void)
-{
-    cl_int status = CL_SUCCESS;
-    cl_command_queue_properties qprops = 0;
+    std::cout << std::left << std::setw(16) << to_string(mode) << std::right << std::fixed << std::setprecision(3)
+              << std::setw(12) << upload_time * 1.0e3
+              << std::setw(12) << kernel_time * 1.0e3
+              << std::setw(12) << download_time * 1.0e3
+              << std::setw(16) << static_cast<cl_ulong>(g_num_particles * static_cast<double>(g_num_steps) / kernel_time)
+              << "   " << (passed ? "PASS" : "FAIL") << std::endl;
 
-    try
-    {
-        qprops |= CL_QUEUE_PROFILING_ENABLE;
+    std::cout.unsetf(std::ios::floatfield);
 
-        g_command_queue = cl::CommandQueue(g_context,
-                                           g_device,
-                                           qprops,
-                                           &status);
-    }
-    catch(cl::Error& e)
-    {
-        std::cout << "set_command_queue() failed (" << status << ") : " << e.what() << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    return kernel_time;
 }
 
 
-static void set_buffers(void)
+struct Interval
 {
-    cl_int status = CL_SUCCESS;
+    cl_ulong start;
+    cl_ulong end;
+};
 
-    try
+static void add_intervals(const std::vector<cl::Event>& events, std::vector<Interval>& intervals)
+{
+    for (const cl::Event& event : events)
     {
-        size_t total_bytes = g_num_particles * sizeof(real2);
-
-        // buffer on GPU
-        // accessed by GPU kernel at very high bandwidths
-        // see https://rocmdocs.amd.com/en/latest/Programming_Guides/Opencl-optimization.html#regular-device-buffers
-        // fails without CL_MEM_USE_HOST_PTR on Windows
-        g_particles_buf = cl::Buffer(g_context,
-                                     CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,
-                                     total_bytes,
-                                     g_particles,
-                                     &status);
-
-        // it remains pinned as long as we don't use it as kernel argument
-        // see https://rocmdocs.amd.com/en/latest/Programming_Guides/Opencl-optimization.html#pre-pinned-buffers
-        // should g_particles be 256-byte aligned??
-        g_pinned_output_buf = cl::Buffer(g_context,
-                                         CL_MEM_USE_HOST_PTR,
-                                         total_bytes,
-                                         g_pin_particles,
-                                         &status);
-
-        // g_output_buffer = cl::Buffer(g_context,
-        //                              CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY,
-        //                              total_bytes,
-        //                              g_out_particles,
-        //                              &status);
-
-        g_output_buffer = cl::Buffer(g_context,
-                                     CL_MEM_WRITE_ONLY,
-                                     total_bytes,
-                                     NULL,
-                                     &status);
+        intervals.push_back({event.getProfilingInfo<CL_PROFILING_COMMAND_START>(),
+                             event.getProfilingInfo<CL_PROFILING_COMMAND_END>()});
     }
-    catch(cl::Error& e)
+}
+
+// seconds in which at least one queue was busy
+static double busy_seconds(std::vector<Interval> intervals)
+{
+    std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b)
+    {
+        return a.start < b.start;
+    });
+
+    cl_ulong busy = 0;
+    cl_ulong start = 0;
+    cl_ulong end = 0;
+
+    for (const Interval& interval : intervals)
     {
-        std::cout << "set_buffers() failed (" << status << ") : " << e.err() << " - " <<  e.what() << std::endl;
-        exit(EXIT_FAILURE);
+        if (interval.start > end)
+        {
+            busy += end - start;
+            start = interval.start;
+        }
+
+        end = std::max(end, interval.end);
     }
-}
 
+    return (busy + end - start) * 1.e-9;
+}
 
-static void set_data(void)
+// device-copy run in slices: slice i is uploaded on the upload queue, all
+// steps run on the compute queue once its upload finished, and it is read
+// back on the download queue after its last step. the kernel runs with a
+// global offset, so particle i keeps its index and its random stream.
+static double run_pipeline(ClRuntime& runtime, cl_uint num_slices, EventRecorder& recorder)
 {
-    // memory size in Bytes for particles
-    const size_t total_bytes = g_num_particles * sizeof(real2);
+    cl::CommandQueue& upload_queue   = runtime.queue(0);
+    cl::CommandQueue& compute_queue  = runtime.queue(1 % runtime.num_queues());
+    cl::CommandQueue& download_queue = runtime.queue(2 % runtime.num_queues());
+
+    HostArray<real2>   positions(g_num_particles);
+    HostArray<real2>   velocities(g_num_particles);
+    HostArray<real>    lifetimes(g_num_particles);
+    HostArray<cl_uint> colors(g_num_particles);
+
+    std::copy(g_init_positions.begin(), g_init_positions.end(), positions.begin());
+    std::copy(g_init_velocities.begin(), g_init_velocities.end(), velocities.begin());
+    std::copy(g_init_lifetimes.begin(), g_init_lifetimes.end(), lifetimes.begin());
+    std::copy(g_init_colors.begin(), g_init_colors.end(), colors.begin());
+
+    DeviceBuffer<real2>   positions_buf(runtime.context(), g_num_particles);
+    DeviceBuffer<real2>   velocities_buf(runtime.context(), g_num_particles);
+    DeviceBuffer<real>    lifetimes_buf(runtime.context(), g_num_particles);
+    DeviceBuffer<cl_uint> colors_buf(runtime.context(), g_num_particles);
+
+    g_kernel.setArg(0, positions_buf.get());
+    g_kernel.setArg(1, velocities_buf.get());
+    g_kernel.setArg(2, lifetimes_buf.get());
+    g_kernel.setArg(3, colors_buf.get());
+
+    // whole work-groups per slice, so only the last one has padding
+    const size_t group_size = g_config.group_elements();
+    const size_t per_slice  = (static_cast<size_t>(g_num_particles) + num_slices - 1) / num_slices;
+    const size_t slice_size = std::max<size_t>((per_slice + group_size - 1) / group_size, 1) * group_size;
+
+    std::vector<cl::Event> upload_events;
+    std::vector<cl::Event> kernel_events;
+    std::vector<cl::Event> download_events;
+
+    for (size_t begin = 0; begin < g_num_particles; begin += slice_size)
+    {
+        const size_t count       = std::min<size_t>(slice_size, g_num_particles - begin);
+        const size_t global_size = g_config.global_size(count);
 
-    // a buffer to be used as float4* must be 128-bit aligned.
-    // see https://rocmdocs.amd.com/en/latest/Programming_Guides/Opencl-optimization.html#using-the-cpu
-    // here we use 8-byte alignment because buffer is used as float2*
-    g_particles     = static_cast<real*>( _aligned_malloc(total_bytes, 8) );
-    g_out_particles = static_cast<real*>( _aligned_malloc(total_bytes, 8) );
-    g_pin_particles = static_cast<real*>( _aligned_malloc(total_bytes, 8) );
+        std::vector<cl::Event> uploaded(4);
 
-    std::random_device rd;
-    static std::uniform_real_distribution<real> xdis(0, 1);
-    static std::uniform_real_distribution<real> ydis(2, 3);
-    static std::default_random_engine generator(rd());
+        upload_queue.enqueueWriteBuffer(positions_buf.get(), CL_FALSE, begin * sizeof(real2), count * sizeof(real2), &positions[begin], NULL, &uploaded[0]);
+        upload_queue.enqueueWriteBuffer(velocities_buf.get(), CL_FALSE, begin * sizeof(real2), count * sizeof(real2), &velocities[begin], NULL, &uploaded[1]);
+        upload_queue.enqueueWriteBuffer(lifetimes_buf.get(), CL_FALSE, begin * sizeof(real), count * sizeof(real), &lifetimes[begin], NULL, &uploaded[2]);
+        upload_queue.enqueueWriteBuffer(colors_buf.get(), CL_FALSE, begin * sizeof(cl_uint), count * sizeof(cl_uint), &colors[begin], NULL, &uploaded[3]);
+        upload_queue.flush();
 
-    for (cl_uint i = 0; i < g_num_particles * 2; i += 2)
-    {
-        g_particles[i]   = xdis(generator);
-        g_particles[i+1] = ydis(generator);
+        upload_events.insert(upload_events.end(), uploaded.begin(), uploaded.end());
 
-        g_out_particles[i]   = 0.0f;
-        g_out_particles[i+1] = 0.0f;
+        // the first step waits for the upload, the in-order queue orders the rest
+        std::vector<cl::Event> wait_list = uploaded;
 
-        g_pin_particles[i]   = 0.0f;
-        g_pin_particles[i+1] = 0.0f;
-    }
-}
+        for (cl_uint step = 0; step < g_num_steps; ++step)
+        {
+            cl::Event event;
 
+            g_kernel.setArg(10, static_cast<cl_ulong>(step));
 
-static void readFileToString(const std::string filename, std::string& contents)
-{
-    std::ifstream stream(filename);
+            compute_queue.enqueueNDRangeKernel(g_kernel,
+                                               cl::NDRange(begin),
+                                               cl::NDRange(global_size),
+                                               cl::NDRange(g_config.local_size),
+                                               &wait_list,
+                                               &event);
 
-    if (!stream.is_open())
-    {
-        std::cerr << "Failed to read file " << filename << std::endl;
-        exit(EXIT_FAILURE);
+            kernel_events.push_back(event);
+            wait_list.assign(1, event);
+        }
+
+        compute_queue.flush();
+
+        std::vector<cl::Event> downloaded(4);
+
+        download_queue.enqueueReadBuffer(positions_buf.get(), CL_FALSE, begin * sizeof(real2), count * sizeof(real2), &positions[begin], &wait_list, &downloaded[0]);
+        download_queue.enqueueReadBuffer(velocities_buf.get(), CL_FALSE, begin * sizeof(real2), count * sizeof(real2), &velocities[begin], &wait_list, &downloaded[1]);
+        download_queue.enqueueReadBuffer(lifetimes_buf.get(), CL_FALSE, begin * sizeof(real), count * sizeof(real), &lifetimes[begin], &wait_list, &downloaded[2]);
+        download_queue.enqueueReadBuffer(colors_buf.get(), CL_FALSE, begin * sizeof(cl_uint), count * sizeof(cl_uint), &colors[begin], &wait_list, &downloaded[3]);
+        download_queue.flush();
+
+        download_events.insert(download_events.end(), downloaded.begin(), downloaded.end());
     }
 
-    contents = std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    runtime.finish();
+
+    recorder.record(upload_events, "upload", 0, "pipeline");
+    recorder.record(kernel_events, g_kernel_name, 1 % runtime.num_queues(), "pipeline");
+    recorder.record(download_events, "download", 2 % runtime.num_queues(), "pipeline");
+
+    const double upload_time   = total_seconds(upload_events);
+    const double kernel_time   = total_seconds(kernel_events);
+    const double download_time = total_seconds(download_events);
+    const double serial_time   = upload_time + kernel_time + download_time;
+
+    // every queue shares the device clock, so the intervals line up
+    std::vector<Interval> intervals;
+    add_intervals(upload_events, intervals);
+    add_intervals(kernel_events, intervals);
+    add_intervals(download_events, intervals);
+
+    const double busy_time = busy_seconds(intervals);
+    const double overlap   = std::max(serial_time - busy_time, 0.0);
+
+    const bool passed = verify_results(positions.data(), velocities.data(), lifetimes.data(), colors.data());
 
-    stream.close();
+    std::cout << "Pipelined device-copy, " << num_slices << " slices over " << runtime.num_queues() << " queues" << std::endl;
+    std::cout << std::fixed << std::setprecision(3)
+              << "upload " << upload_time * 1.0e3 << " ms, kernel " << kernel_time * 1.0e3
+              << " ms, download " << download_time * 1.0e3 << " ms, busy " << busy_time * 1.0e3 << " ms" << std::endl;
+    std::cout << "overlap " << overlap * 1.0e3 << " ms, "
+              << std::setprecision(1) << (upload_time + download_time > 0.0 ? 100.0 * std::min(overlap / (upload_time + download_time), 1.0) : 0.0)
+              << "% of the transfer time hidden   " << (passed ? "PASS" : "FAIL") << std::endl;
+
+    std::cout.unsetf(std::ios::floatfield);
+
+    return busy_time;
 }
 
 
-static void create_program()
+// same steps as integrate_particles in kernel_file.cl
+static void run_host_kernel()
 {
-    cl_int status = CL_SUCCESS;
-
-    try
+    for (cl_uint step = 0; step < g_num_steps; ++step)
     {
-        std::string source_str;
+        for (cl_uint i = 0; i < g_num_particles; ++i)
+        {
+            real2& position = g_host_positions[i];
+            real2& velocity = g_host_velocities[i];
+            real   lifetime = g_host_lifetimes[i] - g_dt;
 
-        readFileToString(g_kernel_file, source_str);
+            if (lifetime <= 0.f)
+            {
+                ParticleRandom rng(g_seed, i);
+                rng.seek(static_cast<std::uint64_t>(step) * 3);
 
-        std::vector<std::string> kernel_strings{source_str};
+                real u[3];
+                rng.fill_uniform(u, 3);
 
-        std::vector<cl::Device> devices(1);
-        devices[0] = g_device;
+                real angle = u[0] * 6.28318531f;
+                real speed = g_spawn.s[0] + g_spawn.s[1] * u[1];
+                lifetime   = g_spawn.s[2] + g_spawn.s[3] * u[2];
 
-        g_program = cl::Program(g_context, kernel_strings, &status);
-        g_program.build(devices, "-cl-std=CL2.0");
-    }
-    catch(cl::Error& e)
-    {
-        std::cerr << "create_program() failed (" << status << ") : " << e.err() << e.what() << std::endl;
-        std::cerr << "Build status: " << g_program.getBuildInfo<CL_PROGRAM_BUILD_STATUS>(g_device) << std::endl;
-        std::cerr << "Build options: " << g_program.getBuildInfo<CL_PROGRAM_BUILD_OPTIONS>(g_device) << std::endl;
-        std::cerr << "Build log: " << g_program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(g_device) << std::endl;
-        exit(EXIT_FAILURE);
+                velocity = {{std::cos(angle) * speed, std::sin(angle) * speed}};
+                position = g_emitter;
+            }
+            else
+            {
+                position.s[0] += velocity.s[0] * g_dt;
+                position.s[1] += velocity.s[1] * g_dt;
+            }
+
+            g_host_lifetimes[i] = lifetime;
+
+            real alpha = std::min(std::max(lifetime * g_inv_lifetime * 255.f, 0.f), 255.f);
+            g_host_colors[i] = (g_host_colors[i] & 0x00FFFFFFu) | (static_cast<cl_uint>(alpha) << 24);
+        }
     }
 }
 
+static cl_uint host_alpha(cl_uint color, real lifetime)
+{
+    real alpha = std::min(std::max(lifetime * g_inv_lifetime * 255.f, 0.f), 255.f);
+    return (color & 0x00FFFFFFu) | (static_cast<cl_uint>(alpha) << 24);
+}
 
-static void create_kernel()
+// one step of particles [begin, end): every particle is advanced without a
+// branch by integrate_particles, with the widest instruction set the CPU
+// has, and the dead ones are respawned after in a scalar pass. a respawn
+// overwrites the position it was advanced to.
+static void host_step(real2* positions,
+                      real2* velocities,
+                      real* lifetimes,
+                      cl_uint* colors,
+                      size_t begin,
+                      size_t end,
+                      cl_uint step,
+                      std::vector<cl_uint>& dead)
 {
-    cl_int status = CL_SUCCESS;
+    static_assert(sizeof(real2) == 2 * sizeof(real), "positions are processed as interleaved x, y floats");
 
-    try
-    {
-        g_kernel = cl::Kernel(g_program, g_kernel_name.data(), &status);
+    KernelArgs args;
+    args.lifetime    = lifetimes;
+    args.position    = reinterpret_cast<float*>(positions);
+    args.velocity    = reinterpret_cast<const float*>(velocities);
+    args.color       = colors;
+    args.dt          = g_dt;
+    args.alpha_scale = g_inv_lifetime * 255.f;
 
-        g_kernel.setArg(0, g_particles_buf);
-        g_kernel.setArg(1, g_output_buffer);
-        g_kernel.setArg(2, g_block_size * sizeof(real2), NULL);
-    }
-    catch(cl::Error& e)
+    dead.clear();
+    integrate_particles(args, begin, end, dead);
+
+    for (cl_uint d : dead)
     {
-        std::cout << "create_kernel() failed (" << status << ") : " << e.err() << e.what() << std::endl;
-        exit(EXIT_FAILURE);
+        ParticleRandom rng(g_seed, d);
+        rng.seek(static_cast<std::uint64_t>(step) * 3);
+
+        real u[3];
+        rng.fill_uniform(u, 3);
+
+        real angle = u[0] * 6.28318531f;
+        real speed = g_spawn.s[0] + g_spawn.s[1] * u[1];
+
+        lifetimes[d]  = g_spawn.s[2] + g_spawn.s[3] * u[2];
+        velocities[d] = {{std::cos(angle) * speed, std::sin(angle) * speed}};
+        positions[d]  = g_emitter;
+        colors[d]     = host_alpha(colors[d], lifetimes[d]);
     }
 }
 
-static void run_kernel()
+// the optimized host baseline: every thread owns a contiguous range of
+// particles and takes it through all steps block by block
+static void run_host_parallel(std::vector<real2>& positions,
+                              std::vector<real2>& velocities,
+                              std::vector<real>& lifetimes,
+                              std::vector<cl_uint>& colors)
 {
-    cl_int status = CL_SUCCESS;
-    std::vector<cl::Event> kernel_event(1);
-    cl::Event data_event;
-
-    try
+    parallel_for(g_num_particles, [&](size_t first, size_t last)
     {
-        size_t total_bytes = g_num_particles * sizeof(real2);
+        std::vector<cl_uint> dead;
+        dead.reserve(g_host_block);
 
-        g_command_queue.enqueueNDRangeKernel(g_kernel,
-                                             cl::NullRange,
-                                             cl::NDRange(g_num_particles),
-                                             cl::NDRange(g_block_size),
-                                             NULL,
-                                             &kernel_event[0]);
+        for (size_t begin = first; begin < last; begin += g_host_block)
+        {
+            const size_t end = std::min(begin + g_host_block, last);
 
-        g_command_queue.enqueueCopyBuffer(g_output_buffer,
-                                          g_pinned_output_buf,
-                                          0,
-                                          0,
-                                          total_bytes,
-                                          &kernel_event,
-                                          &data_event);
+            for (cl_uint step = 0; step < g_num_steps; ++step)
+            {
+                host_step(positions.data(), velocities.data(), lifetimes.data(), colors.data(), begin, end, step, dead);
+            }
+        }
+    });
+}
+
+static bool verify_results(const real2* positions,
+                           const real2* velocities,
+                           const real* lifetimes,
+                           const cl_uint* colors)
+{
+    size_t num_errors = 0;
+
+    for(cl_uint i = 0; i < g_num_particles; ++i)
+    {
+        const real2&  position = positions[i];
+        const real2&  velocity = velocities[i];
+        const real    lifetime = lifetimes[i];
+        const cl_uint color    = colors[i];
+
+        // alpha is truncated to a byte, so allow it to be one step off
+        cl_int alpha_diff = static_cast<cl_int>(color >> 24) - static_cast<cl_int>(g_host_colors[i] >> 24);
+
+        if ( !is_close(position.s[0], g_host_positions[i].s[0]) ||
+             !is_close(position.s[1], g_host_positions[i].s[1]) ||
+             !is_close(velocity.s[0], g_host_velocities[i].s[0]) ||
+             !is_close(velocity.s[1], g_host_velocities[i].s[1]) ||
+             !is_close(lifetime, g_host_lifetimes[i]) ||
+             (color & 0x00FFFFFFu) != (g_host_colors[i] & 0x00FFFFFFu) ||
+             std::abs(alpha_diff) > 1 )
+        {
+            if (num_errors == 0)
+            {
+                std::cerr << "First mismatch at particle " << i << std::endl;
+            }
 
+            ++num_errors;
+        }
     }
-    catch(cl::Error& e)
+
+    if (num_errors > 0)
     {
-        std::cout << "run_kernel() failed (" << status << ") : " << e.err() << e.what() << std::endl;
-        g_command_queue.finish();
-        exit(EXIT_FAILURE);
+        std::cerr << "Verification result: FAIL (" << num_errors << " particles)" << std::endl;
+        return false;
     }
 
-    g_command_queue.finish();
+    return true;
+}
 
-    cl_ulong start;
-    cl_ulong finish;
 
-    try
+// --slices K sets the number of slices of the pipelined run, 0 skips it.
+// a slice holds at least one particle.
+static cl_uint num_slices(int argc, char * argv[])
+{
+    for (int i = 1; i + 1 < argc; ++i)
     {
-        kernel_event[0].getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
-        kernel_event[0].getProfilingInfo(CL_PROFILING_COMMAND_END, &finish);
-
-        std::cout << "Kernel time: " << static_cast<double>((finish - start) * 1.e-9) << std::endl;
+        if (std::string(argv[i]) == "--slices")
+        {
+            const long slices = std::atol(argv[i + 1]);
 
-        data_event.getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
-        data_event.getProfilingInfo(CL_PROFILING_COMMAND_END, &finish);
+            if (slices < 0 || slices > static_cast<long>(g_num_particles))
+            {
+                throw ClRuntimeError("--slices must be between 0 and " + std::to_string(g_num_particles));
+            }
 
-        std::cout << "Data time: " << static_cast<double>((finish - start) * 1.e-9) << std::endl;
-    }
-    catch(cl::Error& e)
-    {
-        std::cout << "Failed to get profiling info (" << status << ") : " << e.err() << e.what() << std::endl;
-        exit(EXIT_FAILURE);
+            return static_cast<cl_uint>(slices);
+        }
     }
-}
 
+    return g_num_slices;
+}
 
-static void run_host_kernel()
+// --buffers MODE runs one buffer mode, by default every mode the device supports runs
+static std::vector<BufferMode> buffer_modes(const ClRuntime& runtime, int argc, char * argv[])
 {
-    real2* particles = reinterpret_cast<real2*>(g_particles);
-
-    for(auto i = 0u; i < g_num_particles; ++i)
+    for (int i = 1; i + 1 < argc; ++i)
     {
-        auto idx = (g_num_particles - 1) - i;
+        if (std::string(argv[i]) != "--buffers" || std::string(argv[i + 1]) == "all")
+        {
+            continue;
+        }
 
-        g_host_particles[i] = particles[idx];
+        BufferMode mode;
+
+        if (!parse_buffer_mode(argv[i + 1], mode))
+        {
+            throw ClRuntimeError(std::string("Unknown buffer mode ") + argv[i + 1]);
+        }
+
+        return std::vector<BufferMode>(1, mode);
     }
+
+    return supported_buffer_modes(runtime);
 }
 
-static void verify_results()
+// --trace FILE writes every command of the runs as a Chrome trace
+static std::string trace_file(int argc, char * argv[])
 {
-    real2* device_results = reinterpret_cast<real2*>(g_pin_particles);
-
-    for(auto i = 0; i < g_num_particles; ++i)
+    for (int i = 1; i + 1 < argc; ++i)
     {
-        if ( !is_close(device_results[i].s[0], g_host_particles[i].s[0]) ||
-             !is_close(device_results[i].s[1], g_host_particles[i].s[1]) )
+        if (std::string(argv[i]) == "--trace")
         {
-            std::cerr << "Verification result: FAIL" << std::endl;
-            return;
+            return argv[i + 1];
         }
     }
 
-    std::cerr << "Verification result: PASS" << std::endl;
+    return "";
 }
 
 
 int main(int argc, char * argv[])
 {
+    // --cpu runs on a CPU runtime such as PoCL, --gpu or --device NAME pick another device
+    const DeviceQuery query = DeviceQuery::from_args(argc, argv);
+
     std::cout.imbue(std::locale(std::cout.getloc(), new space_out));
 
     std::cout << "# particles: " << g_num_particles << std::endl;
+    std::cout << "# steps: " << g_num_steps << std::endl;
 
+    try
+    {
 #ifndef HOST_ONLY
-    set_platform();
-    set_context();
-    set_device();
-    set_command_queue();
+        ClRuntime runtime(query, g_num_queues);
+        print_device_info(std::cout, runtime.device());
+        std::cout << std::endl;
+
+        const std::vector<BufferMode> modes = buffer_modes(runtime, argc, argv);
 #endif
 
-    std::cout << "Setting data" << std::endl;
-    set_data();
+        std::cout << "Setting data" << std::endl;
+        set_data();
+
+        // the naive loop is also the reference every other run is verified against
+        std::vector<SpeedupRow> timings;
 
-    run_host_kernel();
+        HostTimer timer;
+        run_host_kernel();
+        timings.push_back({"particles", "host naive", timer.seconds()});
+
+        {
+            std::vector<real2>   positions  = g_init_positions;
+            std::vector<real2>   velocities = g_init_velocities;
+            std::vector<real>    lifetimes  = g_init_lifetimes;
+            std::vector<cl_uint> colors     = g_init_colors;
+
+            timer.restart();
+            run_host_parallel(positions, velocities, lifetimes, colors);
+
+            const std::string name = "host " + std::to_string(host_threads()) + " threads, " + to_string(particle_kernel_isa());
+            timings.push_back({"particles", name, timer.seconds()});
+
+            const bool passed = verify_results(positions.data(), velocities.data(), lifetimes.data(), colors.data());
+            std::cout << "Host baseline: " << (passed ? "PASS" : "FAIL") << std::endl;
+        }
 
 #ifndef HOST_ONLY
-    std::cout << "Setting buffers" << std::endl;
-    set_buffers();
-    create_program();
-    create_kernel();
-    std::cout << "Running kernel" << std::endl;
-    run_kernel();
-    std::cout << "Done!" << std::endl;
-
-    verify_results();
+        // --tune sweeps the launch shapes and stores the fastest for this device
+        g_config = tuned_config(runtime, KernelTuner::requested(argc, argv));
+        create_kernel(runtime);
+
+        std::cout << "Running kernel, times in ms" << std::endl;
+        std::cout << std::left << std::setw(16) << "buffer mode" << std::right
+                  << std::setw(12) << "upload"
+                  << std::setw(12) << "kernel"
+                  << std::setw(12) << "download"
+                  << std::setw(16) << "particles/s"
+                  << "   verification" << std::endl;
+
+        // every command of every run, for the summary and the trace
+        EventRecorder recorder;
+
+        for (BufferMode mode : modes)
+        {
+            timings.push_back({"particles", std::string("device ") + to_string(mode) + " kernel", run_kernel(runtime, mode, recorder)});
+        }
+
+        const cl_uint slices = num_slices(argc, argv);
+
+        if (slices > 0)
+        {
+            std::cout << std::endl;
+            timings.push_back({"particles", "device pipeline busy", run_pipeline(runtime, slices, recorder)});
+        }
+
+        std::cout << std::endl;
+        recorder.print_summary(std::cout);
+
+        const std::string trace = trace_file(argc, argv);
+
+        if (!trace.empty())
+        {
+            recorder.save_chrome_trace(trace);
+            std::cout << "Trace written to " << trace << ", open it in ui.perfetto.dev" << std::endl;
+        }
+
+        g_kernel = cl::Kernel();
 #endif
 
-    _aligned_free(g_particles);
-    _aligned_free(g_out_particles);
-    _aligned_free(g_pin_particles);
-    g_particles = nullptr;
-    g_out_particles = nullptr;
-    g_pin_particles = nullptr;
+        std::cout << std::endl;
+        print_speedup_table(std::cout, timings);
+
+        std::cout << "Done!" << std::endl;
+    }
+    catch (cl::Error& e)
+    {
+        std::cerr << "OpenCL error: " << e.what() << " (" << e.err() << ")" << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -1,14 +1,113 @@
-__kernel void do_reduction(__global int2* input_a,
-                           __global int2* input_b,
-                           __global int2* output,
-                           __local  int2* local_cache)
+// the host builds this file once per element type and operation:
+//   TYPE     vector type of the elements, e.g. int2 or float2
+//   SCALAR   component type of TYPE, e.g. int or float
+//   IDENTITY scalar identity of the operation, e.g. 0, INT_MAX or -INFINITY
+//   OP_SUM, OP_MIN or OP_MAX
+//   USE_SUBGROUPS when the device has cl_khr_subgroups
+//   VECTOR_WIDTH  elements read per load, 1, 2 or 4 (default 1)
+// the number of work-groups, and so the elements per work-item, is up to the launch
+
+#if defined(OP_SUM)
+#define COMBINE(a, b)  ((a) + (b))
+#define SUB_GROUP_OP   sub_group_reduce_add
+#elif defined(OP_MIN)
+#define COMBINE(a, b)  min(a, b)
+#define SUB_GROUP_OP   sub_group_reduce_min
+#else
+#define COMBINE(a, b)  max(a, b)
+#define SUB_GROUP_OP   sub_group_reduce_max
+#endif
+
+#ifdef USE_SUBGROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+
+#ifndef VECTOR_WIDTH
+#define VECTOR_WIDTH 1
+#endif
+
+#define CONCAT(a, b)  CONCAT_(a, b)
+#define CONCAT_(a, b) a##b
+
+// a load of VECTOR_WIDTH elements is one wider vector of SCALAR
+#if VECTOR_WIDTH == 4
+#define LOAD_TYPE      CONCAT(SCALAR, 8)
+#define FOLD(acc, v)   COMBINE(COMBINE(acc, (v).lo.lo), COMBINE(COMBINE((v).lo.hi, (v).hi.lo), (v).hi.hi))
+#elif VECTOR_WIDTH == 2
+#define LOAD_TYPE      CONCAT(SCALAR, 4)
+#define FOLD(acc, v)   COMBINE(COMBINE(acc, (v).lo), (v).hi)
+#else
+#define LOAD_TYPE      TYPE
+#define FOLD(acc, v)   COMBINE(acc, v)
+#endif
+
+// reduces input[0, count) to one value per work-group in partial[group].
+// launched a second time over the partials with a single work-group it
+// produces the final result in partial[0].
+__kernel void do_reduction(__global const TYPE* input,
+                           __global TYPE* partial,
+                           uint count,
+                           __local TYPE* local_cache)
 {
-    size_t gid = get_global_id(0);
-    size_t lid = get_local_id(0);
+    const uint lid = get_local_id(0);
+
+    // grid-stride loop: every work-item folds many elements in registers
+    // first, so the tree below only combines one value per work-item
+    TYPE acc = (TYPE)(IDENTITY);
+
+    __global const LOAD_TYPE* vectors = (__global const LOAD_TYPE*)input;
+
+    const uint num_vectors = count / VECTOR_WIDTH;
 
-    local_cache[lid] = input_a[gid] + input_b[gid];
+    for (uint i = get_global_id(0); i < num_vectors; i += get_global_size(0))
+    {
+        acc = FOLD(acc, vectors[i]);
+    }
+
+    // the elements after the last whole vector
+    for (uint i = num_vectors * VECTOR_WIDTH + get_global_id(0); i < count; i += get_global_size(0))
+    {
+        acc = COMBINE(acc, input[i]);
+    }
+
+#ifdef USE_SUBGROUPS
+    // the subgroup reduces in registers, one value per subgroup reaches local memory
+    acc.x = SUB_GROUP_OP(acc.x);
+    acc.y = SUB_GROUP_OP(acc.y);
+
+    if (get_sub_group_local_id() == 0)
+    {
+        local_cache[get_sub_group_id()] = acc;
+    }
+
+    uint active = get_num_sub_groups();
+#else
+    local_cache[lid] = acc;
+
+    uint active = get_local_size(0);
+#endif
 
     barrier(CLK_LOCAL_MEM_FENCE);
 
-    output[gid] = local_cache[lid];
+    // tree reduction in local memory, halving the active range until one value
+    // is left. active is the same for the whole work-group, so every
+    // work-item reaches every barrier.
+    while (active > 1)
+    {
+        const uint half = (active + 1) / 2;
+
+        if (lid < active - half)
+        {
+            local_cache[lid] = COMBINE(local_cache[lid], local_cache[lid + half]);
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        active = half;
+    }
+
+    if (lid == 0)
+    {
+        partial[get_group_id(0)] = local_cache[0];
+    }
 }
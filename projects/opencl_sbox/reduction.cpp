@@ -0,0 +1,458 @@
+#include "ClRuntime.hpp"
+#include "HostBaseline.hpp"
+#include "KernelTuner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#define RED   "\x1B[31m"
+#define GRN   "\x1B[32m"
+#define RESET "\x1B[0m"
+
+const size_t         NUM_ELEMENTS = 256u * 256u * 256u;
+const int            ITERATIONS   = 10;      // the best run is reported
+const size_t         HOST_LANES   = 8;       // independent accumulators of the optimized host loop
+const char*          KERNEL_FILE  = "reduction.cl";
+const char*          KERNEL_NAME  = "do_reduction";
+
+enum class ReduceOp
+{
+    Sum,
+    Min,
+    Max
+};
+
+static const ReduceOp ALL_OPS[] = {ReduceOp::Sum, ReduceOp::Min, ReduceOp::Max};
+
+static const char* to_string(ReduceOp op)
+{
+    switch (op)
+    {
+        case ReduceOp::Sum: return "sum";
+        case ReduceOp::Min: return "min";
+        default:            return "max";
+    }
+}
+
+// host side of the element types: V is cl_int2 or cl_float2, S its component
+template <typename S>
+struct ElementTraits;
+
+template <>
+struct ElementTraits<cl_int>
+{
+    using Vector = cl_int2;
+    using Accumulator = long long;
+
+    static const char* type_name()   { return "int2"; }
+    static const char* scalar_name() { return "int"; }
+    static const char* min_identity() { return "INT_MAX"; }
+    static const char* max_identity() { return "INT_MIN"; }
+
+    static bool is_close(cl_int a, cl_int b) { return a == b; }
+};
+
+template <>
+struct ElementTraits<cl_float>
+{
+    using Vector = cl_float2;
+    using Accumulator = double;
+
+    static const char* type_name()   { return "float2"; }
+    static const char* scalar_name() { return "float"; }
+    static const char* min_identity() { return "INFINITY"; }
+    static const char* max_identity() { return "-INFINITY"; }
+
+    // the device adds in a different order than the host
+    static bool is_close(cl_float a, cl_float b)
+    {
+        return std::fabs(a - b) <= 1.e-5f * std::max(std::fabs(a), std::fabs(b)) + 1.e-3f;
+    }
+};
+
+static bool has_subgroups(const cl::Device& device)
+{
+    return device.getInfo<CL_DEVICE_EXTENSIONS>().find("cl_khr_subgroups") != std::string::npos;
+}
+
+template <typename S>
+static std::string build_options(ReduceOp op, bool subgroups, const KernelConfig& config)
+{
+    using Traits = ElementTraits<S>;
+
+    std::string options = "-Werror -D TYPE=";
+    options += Traits::type_name();
+    options += " -D SCALAR=";
+    options += Traits::scalar_name();
+
+    switch (op)
+    {
+        case ReduceOp::Sum: options += " -D OP_SUM -D IDENTITY=0"; break;
+        case ReduceOp::Min: options += std::string(" -D OP_MIN -D IDENTITY=") + Traits::min_identity(); break;
+        case ReduceOp::Max: options += std::string(" -D OP_MAX -D IDENTITY=") + Traits::max_identity(); break;
+    }
+
+    // subgroup functions need OpenCL C 2.0
+    options += subgroups ? " -D USE_SUBGROUPS -cl-std=CL2.0" : " -cl-std=CL1.2";
+
+    return options + config.build_options();
+}
+
+// values in [-100, 100], so an int2 sum of 256^3 elements cannot overflow
+template <typename S>
+static void set_data(HostArray<typename ElementTraits<S>::Vector>& data)
+{
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i].s[0] = static_cast<S>(rand() % 201 - 100);
+        data[i].s[1] = static_cast<S>(rand() % 201 - 100);
+    }
+}
+
+template <typename S>
+static typename ElementTraits<S>::Vector host_reduce(const HostArray<typename ElementTraits<S>::Vector>& data, ReduceOp op)
+{
+    using Accumulator = typename ElementTraits<S>::Accumulator;
+
+    typename ElementTraits<S>::Vector result;
+
+    for (int c = 0; c < 2; ++c)
+    {
+        Accumulator acc = 0;
+
+        if (op == ReduceOp::Min)
+        {
+            acc = std::numeric_limits<S>::max();
+        }
+        else if (op == ReduceOp::Max)
+        {
+            acc = std::numeric_limits<S>::lowest();
+        }
+
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            const Accumulator value = data[i].s[c];
+
+            switch (op)
+            {
+                case ReduceOp::Sum: acc += value; break;
+                case ReduceOp::Min: acc = std::min(acc, value); break;
+                case ReduceOp::Max: acc = std::max(acc, value); break;
+            }
+        }
+
+        result.s[c] = static_cast<S>(acc);
+    }
+
+    return result;
+}
+
+template <typename S>
+static S combine(ReduceOp op, S a, S b)
+{
+    switch (op)
+    {
+        case ReduceOp::Sum: return a + b;
+        case ReduceOp::Min: return std::min(a, b);
+        default:            return std::max(a, b);
+    }
+}
+
+template <typename S>
+static S identity(ReduceOp op)
+{
+    switch (op)
+    {
+        case ReduceOp::Sum: return S(0);
+        case ReduceOp::Min: return std::numeric_limits<S>::has_infinity ? std::numeric_limits<S>::infinity() : std::numeric_limits<S>::max();
+        default:            return std::numeric_limits<S>::has_infinity ? -std::numeric_limits<S>::infinity() : std::numeric_limits<S>::lowest();
+    }
+}
+
+// the optimized host baseline: one contiguous range per thread, folded into
+// HOST_LANES independent accumulators that the compiler keeps in vector
+// registers, so the loop has no dependency chain on a single value. the
+// components are interleaved, even lanes hold x and odd lanes y.
+template <typename S>
+static typename ElementTraits<S>::Vector host_reduce_parallel(const HostArray<typename ElementTraits<S>::Vector>& data, ReduceOp op)
+{
+    static_assert(HOST_LANES % 2 == 0, "every lane holds one component");
+
+    const S*     values = reinterpret_cast<const S*>(data.data());
+    const size_t count  = data.size() * 2;
+
+    const size_t num_threads = host_threads();
+
+    std::vector<S> partials(num_threads * 2, identity<S>(op));
+
+    parallel_for(num_threads, [&](size_t first_thread, size_t last_thread)
+    {
+        for (size_t t = first_thread; t < last_thread; ++t)
+        {
+            // the element range of thread t, an even number of scalars
+            const size_t chunk = (data.size() + num_threads - 1) / num_threads * 2;
+            const size_t begin = std::min(t * chunk, count);
+            const size_t end   = std::min(begin + chunk, count);
+
+            S lanes[HOST_LANES];
+            std::fill(lanes, lanes + HOST_LANES, identity<S>(op));
+
+            size_t i = begin;
+
+            for (; i + HOST_LANES <= end; i += HOST_LANES)
+            {
+                for (size_t lane = 0; lane < HOST_LANES; ++lane)
+                {
+                    lanes[lane] = combine(op, lanes[lane], values[i + lane]);
+                }
+            }
+
+            for (; i < end; ++i)
+            {
+                lanes[i % 2] = combine(op, lanes[i % 2], values[i]);
+            }
+
+            for (size_t lane = 0; lane < HOST_LANES; ++lane)
+            {
+                partials[2 * t + lane % 2] = combine(op, partials[2 * t + lane % 2], lanes[lane]);
+            }
+        }
+    }, num_threads);
+
+    typename ElementTraits<S>::Vector result;
+    result.s[0] = identity<S>(op);
+    result.s[1] = identity<S>(op);
+
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        result.s[0] = combine(op, result.s[0], partials[2 * t]);
+        result.s[1] = combine(op, result.s[1], partials[2 * t + 1]);
+    }
+
+    return result;
+}
+
+static double gigabytes_per_second(size_t bytes, double seconds)
+{
+    return seconds > 0.0 ? bytes / seconds * 1.0e-9 : 0.0;
+}
+
+// both passes over `input`, returns their device time. the elements per
+// work-item of the configuration decide how many partials the first pass
+// leaves for the single work-group of the second.
+template <typename Vector>
+static double reduce(ClRuntime& runtime,
+                     cl::Kernel& kernel,
+                     const KernelConfig& config,
+                     const DeviceBuffer<Vector>& input,
+                     DeviceBuffer<Vector>& partials,
+                     DeviceBuffer<Vector>& result)
+{
+    cl::CommandQueue& queue = runtime.queue();
+
+    const size_t num_groups = config.global_size(input.size()) / config.local_size;
+
+    if (partials.size() < num_groups)
+    {
+        partials = DeviceBuffer<Vector>(runtime.context(), num_groups);
+    }
+
+    cl::Event first_pass;
+    cl::Event second_pass;
+
+    // first pass: one partial per work-group
+    kernel.setArg(0, input.get());
+    kernel.setArg(1, partials.get());
+    kernel.setArg(2, static_cast<cl_uint>(input.size()));
+    kernel.setArg(3, cl::Local(config.local_size * sizeof(Vector)));
+
+    queue.enqueueNDRangeKernel(kernel,
+                               cl::NullRange,
+                               cl::NDRange(num_groups * config.local_size),
+                               cl::NDRange(config.local_size),
+                               NULL,
+                               &first_pass);
+
+    // second pass: a single work-group combines the partials
+    kernel.setArg(0, partials.get());
+    kernel.setArg(1, result.get());
+    kernel.setArg(2, static_cast<cl_uint>(num_groups));
+
+    queue.enqueueNDRangeKernel(kernel,
+                               cl::NullRange,
+                               cl::NDRange(config.local_size),
+                               cl::NDRange(config.local_size),
+                               NULL,
+                               &second_pass);
+    queue.finish();
+
+    return elapsed_seconds(first_pass) + elapsed_seconds(second_pass);
+}
+
+// the stored launch shape of one element type on this device; with `sweep`
+// the sum is timed for every shape first and the fastest one is stored.
+// min and max read the same data and launch with the same shape.
+template <typename S>
+static KernelConfig tuned_config(ClRuntime& runtime,
+                                 bool subgroups,
+                                 bool sweep,
+                                 const DeviceBuffer<typename ElementTraits<S>::Vector>& input)
+{
+    using Vector = typename ElementTraits<S>::Vector;
+
+    const std::string name = std::string(KERNEL_NAME) + "/" + ElementTraits<S>::type_name();
+
+    KernelTuner tuner(runtime);
+
+    DeviceBuffer<Vector> partials;
+    DeviceBuffer<Vector> result(runtime.context(), 1);
+
+    TuneSpace space;
+    space.items_per_work_item = {16, 32, 64, 128, 256};
+    space.vector_widths       = {1, 2, 4};
+
+    // 1024 partials with the default 256 work-items per group
+    KernelConfig fallback;
+    fallback.items_per_work_item = 64;
+
+    cl::Kernel probe = runtime.kernel(KERNEL_FILE, KERNEL_NAME, build_options<S>(ReduceOp::Sum, subgroups, fallback));
+
+    tuner.add_kernel(name, probe, space, fallback, [&](const KernelConfig& config)
+    {
+        cl::Kernel kernel = runtime.kernel(KERNEL_FILE, KERNEL_NAME, build_options<S>(ReduceOp::Sum, subgroups, config));
+        return reduce(runtime, kernel, config, input, partials, result);
+    });
+
+    if (sweep)
+    {
+        tuner.tune(std::cout);
+    }
+
+    const KernelConfig config = tuner.config(name);
+
+    std::cout << name << " launch : " << config
+              << (tuner.is_tuned(name) ? " (tuned)" : " (default, --tune sweeps)") << std::endl;
+
+    return config;
+}
+
+// sum, min and max of one element type, each verified against the host
+template <typename S>
+static bool run_reductions(ClRuntime& runtime, bool subgroups, bool sweep, std::vector<SpeedupRow>& timings)
+{
+    using Vector = typename ElementTraits<S>::Vector;
+
+    cl::CommandQueue& queue = runtime.queue();
+
+    HostArray<Vector> data(NUM_ELEMENTS);
+    set_data<S>(data);
+
+    DeviceBuffer<Vector> input(runtime.context(), NUM_ELEMENTS, CL_MEM_READ_ONLY);
+    input.write(queue, data.data());
+
+    const KernelConfig config = tuned_config<S>(runtime, subgroups, sweep, input);
+
+    DeviceBuffer<Vector> partials;
+    DeviceBuffer<Vector> result(runtime.context(), 1);
+
+    bool passed = true;
+
+    for (ReduceOp op : ALL_OPS)
+    {
+        cl::Kernel kernel = runtime.kernel(KERNEL_FILE, KERNEL_NAME, build_options<S>(op, subgroups, config));
+
+        double best_time = std::numeric_limits<double>::max();
+
+        for (int iteration = 0; iteration < ITERATIONS; ++iteration)
+        {
+            best_time = std::min(best_time, reduce(runtime, kernel, config, input, partials, result));
+        }
+
+        Vector device_result;
+        result.read(queue, &device_result);
+
+        Vector host_result;
+        Vector parallel_result;
+
+        const double host_time = best_seconds(ITERATIONS, [&]() { host_result = host_reduce<S>(data, op); });
+        const double parallel_time = best_seconds(ITERATIONS, [&]() { parallel_result = host_reduce_parallel<S>(data, op); });
+
+        const bool ok = ElementTraits<S>::is_close(device_result.s[0], host_result.s[0]) &&
+                        ElementTraits<S>::is_close(device_result.s[1], host_result.s[1]) &&
+                        ElementTraits<S>::is_close(parallel_result.s[0], host_result.s[0]) &&
+                        ElementTraits<S>::is_close(parallel_result.s[1], host_result.s[1]);
+
+        passed = passed && ok;
+
+        std::cout << to_string(op) << " " << ElementTraits<S>::type_name()
+                  << " : (" << device_result.s[0] << ", " << device_result.s[1] << ")"
+                  << "  device " << best_time * 1.0e3 << " ms, " << gigabytes_per_second(data.bytes(), best_time) << " GB/s"
+                  << "  host " << parallel_time * 1.0e3 << " ms, " << gigabytes_per_second(data.bytes(), parallel_time) << " GB/s"
+                  << "  " << (ok ? GRN "PASS" RESET : RED "FAIL" RESET) << std::endl;
+
+        const std::string group = std::string(to_string(op)) + " " + ElementTraits<S>::type_name();
+
+        timings.push_back({group, "host naive", host_time});
+        timings.push_back({group, "host " + std::to_string(host_threads()) + " threads, " + std::to_string(HOST_LANES) + " lanes", parallel_time});
+        timings.push_back({group, "device", best_time});
+    }
+
+    return passed;
+}
+
+
+int main(int argc, char* argv[])
+{
+    srand(static_cast<unsigned int>(time(NULL)));
+
+    try
+    {
+        ClRuntime runtime(DeviceQuery::from_args(argc, argv));
+        print_device_info(std::cout, runtime.device());
+
+        const bool subgroups = has_subgroups(runtime.device());
+
+        std::cout << "\n# elements : " << NUM_ELEMENTS << std::endl;
+        std::cout << "Subgroup reductions : " << (subgroups ? "Yes" : "No") << "\n" << std::endl;
+
+        // --tune sweeps the launch shapes and stores the fastest for this device
+        const bool sweep = KernelTuner::requested(argc, argv);
+
+        // the first run compiles the kernels, later runs load the cached binaries
+        std::vector<SpeedupRow> timings;
+
+        bool passed = run_reductions<cl_int>(runtime, subgroups, sweep, timings);
+        passed = run_reductions<cl_float>(runtime, subgroups, sweep, timings) && passed;
+
+        std::cout << std::endl;
+        print_speedup_table(std::cout, timings);
+
+        std::cout << "\nPrograms compiled : " << runtime.programs().source_builds()
+                  << ", loaded from cache : " << runtime.programs().binary_loads() << std::endl;
+
+        std::cerr << "Verification result : " << (passed ? "PASS" : "FAIL") << std::endl;
+
+        if (!passed)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    catch (cl::Error& e)
+    {
+        std::cerr << RED "OpenCL error: " << e.what() << " (" << e.err() << ")" RESET << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << RED << e.what() << RESET << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
\ No newline at end of file
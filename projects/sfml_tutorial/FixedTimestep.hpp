@@ -0,0 +1,88 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+
+// turns wall-clock time into whole simulation steps of a fixed length.
+// elapsed time goes into an accumulator and advance() hands out the steps it
+// holds, so the simulation does the same work per simulated second and
+// behaves the same at any frame rate. a stall (a slow draw, a window drag)
+// would ask for a burst of steps that takes longer than the stall itself;
+// at most max_substeps run per call and the rest of the backlog is dropped,
+// so the simulation slows down instead of falling further behind.
+class FixedTimestep
+{
+public:
+    explicit FixedTimestep(sf::Time step = sf::seconds(1.f / 60.f), unsigned int max_substeps = 4)
+    : m_step(step),
+      m_max_substeps(max_substeps ? max_substeps : 1),
+      m_accumulator(sf::Time::Zero),
+      m_dropped(sf::Time::Zero),
+      m_steps(0)
+    {}
+
+    // adds the elapsed time and returns the number of steps to run now
+    unsigned int advance(sf::Time elapsed)
+    {
+        m_accumulator += elapsed;
+
+        unsigned int steps = 0;
+
+        while (m_accumulator >= m_step && steps < m_max_substeps)
+        {
+            m_accumulator -= m_step;
+            ++steps;
+        }
+
+        // whole steps over the limit are dropped, the fraction is kept
+        if (m_accumulator >= m_step)
+        {
+            const sf::Time fraction = sf::microseconds(m_accumulator.asMicroseconds() % m_step.asMicroseconds());
+
+            m_dropped     += m_accumulator - fraction;
+            m_accumulator  = fraction;
+        }
+
+        m_steps += steps;
+
+        return steps;
+    }
+
+    sf::Time step() const
+    {
+        return m_step;
+    }
+
+    // how far the wall clock is past the last step, as a fraction of a step.
+    // drawing the state that far between the step before and the last one
+    // shows motion as smooth as the frame rate with one step of latency.
+    float alpha() const
+    {
+        return m_accumulator.asSeconds() / m_step.asSeconds();
+    }
+
+    // wall time until the next step is due
+    sf::Time until_next() const
+    {
+        return m_step - m_accumulator;
+    }
+
+    // wall time thrown away by the catch-up limit
+    sf::Time dropped() const
+    {
+        return m_dropped;
+    }
+
+    // steps handed out so far
+    std::uint64_t steps() const
+    {
+        return m_steps;
+    }
+
+private:
+    sf::Time      m_step;
+    unsigned int  m_max_substeps;
+    sf::Time      m_accumulator;
+    sf::Time      m_dropped;
+    std::uint64_t m_steps;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FixedTimestep.hpp"
+#include "ParticleFrame.hpp"
+
+// a frame counter one thread advances and the other waits on. the waiter
+// spins for a moment, since the other side is usually about to finish, and
+// then sleeps on a condition variable so it does not take a core from the
+// worker pool during a long draw or a vsync wait. advancing is a plain
+// atomic store; the mutex is only taken while the waiter sleeps.
+class FrameCounter
+{
+public:
+    explicit FrameCounter(unsigned long value)
+    : m_value(value),
+      m_sleeping(false)
+    {}
+
+    unsigned long load() const
+    {
+        return m_value.load(std::memory_order_acquire);
+    }
+
+    void store(unsigned long value)
+    {
+        // both sequentially consistent: either the waiter sees the new value
+        // before it sleeps, or this side sees it sleeping
+        m_value.store(value);
+
+        if (m_sleeping.load())
+        {
+            wake();
+        }
+    }
+
+    // wakes the waiter to look at a stop flag
+    void wake()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake.notify_one();
+    }
+
+    // waits until the counter is above `value`, or until *stop is set.
+    // returns false on stop.
+    bool wait_above(unsigned long value, const std::atomic<bool>* stop = nullptr)
+    {
+        for (unsigned int spin = 0; spin < SPINS; ++spin)
+        {
+            if (load() > value)
+            {
+                return true;
+            }
+
+            if (stop != nullptr && *stop)
+            {
+                return false;
+            }
+
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_sleeping = true;
+        m_wake.wait(lock, [&]() { return m_value.load() > value || (stop != nullptr && *stop); });
+        m_sleeping = false;
+
+        return m_value.load() > value;
+    }
+
+private:
+    static const unsigned int SPINS = 64;
+
+    std::atomic<unsigned long> m_value;
+    std::atomic<bool>          m_sleeping;
+    std::mutex                 m_mutex;
+    std::condition_variable    m_wake;
+};
+
+// overlaps updating a particle class with drawing it. a simulation thread
+// fills frame N + 1 while the render thread draws frame N, so a frame costs
+// about max(update, draw) instead of update + draw. the threads meet once per
+// rendered frame: frame() waits until the frame started by the previous call
+// is built, hands over the steps and posted commands of the next update and
+// returns the built frame. on the usual path the handoff is two atomic
+// counters; only a side that waits longer than a short spin sleeps.
+//
+// the render thread turns its frame time into fixed steps with a
+// FixedTimestep, so a slow draw never reaches update() as a huge dt. the
+// frame on screen is placed between its last two steps by the fraction of
+// a step left over, as with SimulationThread, but every rendered frame gets
+// exactly one batch of steps and the frame on screen is one batch behind.
+//
+// System needs update(sf::Time) and build_frame(ParticleFrame&) const.
+template <typename System>
+class FramePipeline
+{
+public:
+    typedef std::function<void(System&)> Command;
+
+    FramePipeline(System& system, const FixedTimestep& timestep)
+    : m_system(system),
+      m_step(timestep.step()),
+      m_built(0),
+      m_handed(1), // frame 0 is the initial state and needs no input
+      m_stop(false),
+      m_timestep(timestep),
+      m_frame(0),
+      m_alpha(1.f),
+      m_waited(sf::Time::Zero)
+    {
+        m_inputs[0].steps = 0;
+        m_inputs[1].steps = 0;
+
+        m_thread = std::thread(&FramePipeline::run, this);
+    }
+
+    ~FramePipeline()
+    {
+        m_stop = true;
+        m_handed.wake();
+        m_thread.join();
+    }
+
+    FramePipeline(const FramePipeline&)            = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // render thread only. runs on the simulation thread before the steps
+    // that the next frame() call starts.
+    void post(Command command)
+    {
+        m_pending.push_back(std::move(command));
+    }
+
+    // the frame built while the previous one was drawn. starts the steps due
+    // after `elapsed` and stays valid and unchanged until the next call.
+    const ParticleFrame& frame(sf::Time elapsed)
+    {
+        sf::Clock wait;
+        m_built.wait_above(m_frame);
+        m_waited = wait.getElapsedTime();
+
+        // the simulation finished with these inputs when it built the frame
+        // before this one
+        Input& next = m_inputs[(m_frame + 1) % 2];
+        next.steps = m_timestep.advance(elapsed);
+        next.commands.swap(m_pending);
+
+        m_handed.store(m_frame + 2);
+
+        // the leftover fraction of the steps behind this frame, taken when
+        // they were handed over
+        ParticleFrame& frame = m_frames[m_frame++ % 2];
+        frame.set_alpha(m_alpha);
+
+        m_alpha = m_timestep.alpha();
+
+        return frame;
+    }
+
+    // frame() with the time since the previous call
+    const ParticleFrame& frame()
+    {
+        return frame(m_clock.restart());
+    }
+
+    // how long the last frame() call waited for the simulation, near zero
+    // while drawing is the slower half
+    sf::Time waited() const
+    {
+        return m_waited;
+    }
+
+    // draw every frame through one ring of streaming GPU buffers. from the
+    // render thread before the first frame() call; returns false and keeps
+    // the vertex arrays if buffers are not available.
+    bool use_vertex_buffers(unsigned int ring_size = 3)
+    {
+        if (!m_ring.create(ring_size))
+        {
+            return false;
+        }
+
+        for (unsigned int i = 0; i < 2; ++i)
+        {
+            m_frames[i].use_vertex_ring(&m_ring);
+        }
+
+        return true;
+    }
+
+    const UploadStats& upload_stats() const
+    {
+        return m_ring.stats();
+    }
+
+private:
+    // what the render thread hands over for one frame
+    struct Input
+    {
+        unsigned int         steps;
+        std::vector<Command> commands;
+    };
+
+    void run()
+    {
+        for (unsigned long frame = 0; m_handed.wait_above(frame, &m_stop); ++frame)
+        {
+            Input& input = m_inputs[frame % 2];
+
+            for (Command& command : input.commands)
+            {
+                command(m_system);
+            }
+
+            // cleared here so the render thread swaps an empty vector back in
+            input.commands.clear();
+
+            sf::Clock timer;
+
+            for (unsigned int step = 0; step < input.steps; ++step)
+            {
+                m_system.update(m_step);
+            }
+
+            const sf::Time update_time = timer.restart();
+
+            // the render thread drew this frame two calls ago
+            ParticleFrame& target = m_frames[frame % 2];
+            m_system.build_frame(target);
+
+            target.step        = m_step.asSeconds();
+            target.update_time = update_time;
+            target.build_time  = timer.getElapsedTime();
+            target.published.restart();
+
+            m_built.store(frame + 1);
+        }
+    }
+
+    System&  m_system;
+    sf::Time m_step;
+
+    // frame N lives in m_frames[N % 2] and is updated with m_inputs[N % 2]
+    ParticleFrame m_frames[2];
+    Input         m_inputs[2];
+
+    FrameCounter      m_built;  // frames the simulation has finished
+    FrameCounter      m_handed; // frames whose input is ready
+    std::atomic<bool> m_stop;
+
+    // render thread only
+    FixedTimestep        m_timestep;
+    unsigned long        m_frame; // the next frame to draw
+    float                m_alpha; // of the steps handed over last
+    std::vector<Command> m_pending;
+    sf::Clock            m_clock;
+    sf::Time             m_waited;
+    VertexRing           m_ring;
+
+    std::thread m_thread;
+};
@@ -1,5 +1,28 @@
 #include "MyEntity.hpp"
-#include <cmath>
+
+static const sf::Color COLORS[] = {sf::Color::Red, sf::Color::Green, sf::Color::Blue};
+
+// respawned particles get a speed and a lifetime in these ranges, the alpha
+// fades over 3 seconds
+static SpawnParams spawn_params()
+{
+    SpawnParams spawn;
+    spawn.emitter      = sf::Vector2f(0.f, 0.f);
+    spawn.speed_min    = 50.f;
+    spawn.speed_max    = 100.f;
+    spawn.lifetime_min = 2.f;
+    spawn.lifetime_max = 4.f;
+    spawn.inv_lifetime = 1.f / 3.f;
+    return spawn;
+}
+
+MyEntity::MyEntity(unsigned int count)
+: ParticleSimulation(count,
+                     spawn_params(),
+                     std::vector<sf::Color>(COLORS, COLORS + 3),
+                     WorkerPool::cache_line_elements(sizeof(sf::Vertex))),
+  m_vertices(sf::Points, count)
+{}
 
 void MyEntity::draw(sf::RenderTarget& target,
                     sf::RenderStates states) const
@@ -11,49 +34,43 @@ void MyEntity::draw(sf::RenderTarget& target,
     // textures are not used
     states.texture = NULL;
 
-    // draw the vertex array
-    target.draw(m_vertices, states);
-}
-
-void MyEntity::reset_particle(std::size_t index)
-{
-    // give random velocity and lifetime to the particle
-    float angle = (std::rand() % 360) * 3.14f / 180.f;
-    float speed = (std::rand() % 50) + 50.f;
-    m_particles[index].velocity = sf::Vector2f(std::cos(angle) * speed, std::sin(angle) * speed);
-    m_particles[index].lifetime = sf::milliseconds((std::rand() % 2000) + 2000);
+    // only the live particles at the front of the store are drawn
+    const std::size_t live = m_store.live;
 
-    // reset the position of the corresponding vertex
-    m_vertices[index].position = m_emitter;
+    if (live == 0)
+    {
+        return;
+    }
 
-    std::vector<sf::Color> colors = {sf::Color::Red, sf::Color::Green, sf::Color::Blue};
-    m_vertices[index].color = colors[index % 3];
+    target.draw(&m_vertices[0], live, sf::Points, states);
 }
 
-void MyEntity::set_emitter(sf::Vector2f position)
+void MyEntity::write_vertices(std::size_t begin, std::size_t end)
 {
-    m_emitter = position;
+    // mirror the store into the vertices that get drawn
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        m_vertices[i].position = m_store.position[i];
+        m_vertices[i].color    = m_store.color[i];
+    }
 }
 
-void MyEntity::update(sf::Time elapsed)
+void MyEntity::build_frame(ParticleFrame& frame) const
 {
-    for (std::size_t i = 0; i < m_particles.size(); ++i)
-    {
-        // update particle lifetime
-        Particle& p = m_particles[i];
-        p.lifetime -= elapsed;
+    const std::size_t live = m_store.live;
+
+    frame.reset(sf::Points, live, 1);
+    frame.shader    = nullptr;
+    frame.transform = getTransform();
 
-        // if the particle is dead then respawn it
-        if (p.lifetime <= sf::Time::Zero)
+    auto copy_range = [&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
         {
-            reset_particle(i);
+            frame.vertices[i] = m_vertices[i];
+            frame.velocity[i] = m_store.velocity[i];
         }
+    };
 
-        // update the position of the corresponding vertex
-        m_vertices[i].position += p.velocity * elapsed.asSeconds();
-
-        // update the alpha (transparency) of the particle according to its lifetime
-        float ratio = p.lifetime.asSeconds() / m_lifetime.asSeconds();
-        m_vertices[i].color.a = static_cast<sf::Uint8>(ratio * 255);
-    }
-}
\ No newline at end of file
+    parallel_for(live, copy_range);
+}
@@ -1,35 +1,27 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 
-class MyEntity : public sf::Drawable, public sf::Transformable
+#include "ParticleFrame.hpp"
+#include "ParticleSimulation.hpp"
+
+class MyEntity : public sf::Drawable, public sf::Transformable, public ParticleSimulation
 {
 private:
     virtual void draw(sf::RenderTarget& target,
                       sf::RenderStates states) const;
 
 private:
-    struct Particle
-    {
-        sf::Vector2f velocity;
-        sf::Time     lifetime;
-    };
-
-    void reset_particle(std::size_t index);
+    virtual void write_vertices(std::size_t begin, std::size_t end);
 
-    std::vector<Particle> m_particles;
-    sf::VertexArray       m_vertices;
-    sf::Time              m_lifetime;
-    sf::Vector2f          m_emitter;
+    // the store is integrated by the vectorized kernel, the vertices only mirror it for drawing
+    sf::VertexArray m_vertices;
 
 public:
-    MyEntity(unsigned int count)
-    : m_particles(count),
-      m_vertices(sf::Points, count),
-      m_lifetime(sf::seconds(3.f)),
-      m_emitter(0.f, 0.f)
-    {}
-
-    void set_emitter(sf::Vector2f position);
+    // points have no size of their own, set_collision_radius() gives the
+    // size of the discs they collide as
+    MyEntity(unsigned int count);
 
-    void update(sf::Time elapsed);
+    // copies what draw() shows into a frame that another thread can draw
+    // while the next update runs
+    void build_frame(ParticleFrame& frame) const;
 };
\ No newline at end of file
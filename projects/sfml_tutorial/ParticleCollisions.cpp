@@ -0,0 +1,253 @@
+#include "ParticleCollisions.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// runs task(chunk, begin, end) over [0, count) on the pool, or inline
+static void run_chunks(WorkerPool* pool, std::size_t count, std::size_t alignment, const WorkerPool::Task& task)
+{
+    if (pool == nullptr)
+    {
+        task(0, 0, count);
+    }
+    else
+    {
+        pool->parallel_for(count, alignment, task);
+    }
+}
+
+SpatialGrid::SpatialGrid()
+: m_origin(0.f, 0.f),
+  m_cell_size(1.f),
+  m_inv_cell_size(1.f),
+  m_columns(1),
+  m_rows(1),
+  m_cell_start(2, 0)
+{}
+
+float SpatialGrid::cell_size() const
+{
+    return m_cell_size;
+}
+
+std::size_t SpatialGrid::num_cells() const
+{
+    return m_columns * m_rows;
+}
+
+const std::vector<std::uint32_t>& SpatialGrid::sorted_indices() const
+{
+    return m_indices;
+}
+
+long SpatialGrid::cell_coordinate(float offset) const
+{
+    return static_cast<long>(std::floor(offset * m_inv_cell_size));
+}
+
+void SpatialGrid::build(const sf::Vector2f* positions, std::size_t count, float cell_size, WorkerPool* pool)
+{
+    const std::size_t num_chunks = pool ? pool->size() : 1;
+    const std::size_t alignment  = WorkerPool::cache_line_elements(sizeof(sf::Vector2f));
+
+    // bounding box, reduced per chunk
+    const float infinity = std::numeric_limits<float>::max();
+
+    m_chunk_min.assign(num_chunks, sf::Vector2f(infinity, infinity));
+    m_chunk_max.assign(num_chunks, sf::Vector2f(-infinity, -infinity));
+
+    run_chunks(pool, count, alignment, [&](std::size_t chunk, std::size_t begin, std::size_t end)
+    {
+        sf::Vector2f low  = m_chunk_min[chunk];
+        sf::Vector2f high = m_chunk_max[chunk];
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            low.x  = std::min(low.x, positions[i].x);
+            low.y  = std::min(low.y, positions[i].y);
+            high.x = std::max(high.x, positions[i].x);
+            high.y = std::max(high.y, positions[i].y);
+        }
+
+        m_chunk_min[chunk] = low;
+        m_chunk_max[chunk] = high;
+    });
+
+    sf::Vector2f low  = m_chunk_min[0];
+    sf::Vector2f high = m_chunk_max[0];
+
+    for (std::size_t chunk = 1; chunk < num_chunks; ++chunk)
+    {
+        low.x  = std::min(low.x, m_chunk_min[chunk].x);
+        low.y  = std::min(low.y, m_chunk_min[chunk].y);
+        high.x = std::max(high.x, m_chunk_max[chunk].x);
+        high.y = std::max(high.y, m_chunk_max[chunk].y);
+    }
+
+    if (count == 0)
+    {
+        low = high = sf::Vector2f(0.f, 0.f);
+    }
+
+    // widen the cells until there are at most about two per point
+    const float width  = high.x - low.x;
+    const float height = high.y - low.y;
+    const float limit  = 2.f * static_cast<float>(std::max<std::size_t>(count, 1));
+
+    m_cell_size = std::max(cell_size, 1.e-6f);
+
+    while ((width / m_cell_size + 1.f) * (height / m_cell_size + 1.f) > limit)
+    {
+        m_cell_size *= 1.5f;
+    }
+
+    m_origin        = low;
+    m_inv_cell_size = 1.f / m_cell_size;
+    m_columns       = static_cast<std::size_t>(width * m_inv_cell_size) + 1;
+    m_rows          = static_cast<std::size_t>(height * m_inv_cell_size) + 1;
+
+    // the cell of every point
+    m_cell_of.resize(count);
+
+    run_chunks(pool, count, alignment, [&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const std::size_t x = std::min(static_cast<std::size_t>((positions[i].x - m_origin.x) * m_inv_cell_size), m_columns - 1);
+            const std::size_t y = std::min(static_cast<std::size_t>((positions[i].y - m_origin.y) * m_inv_cell_size), m_rows - 1);
+
+            m_cell_of[i] = static_cast<std::uint32_t>(y * m_columns + x);
+        }
+    });
+
+    // counting sort: histogram, exclusive prefix sum, scatter. two linear
+    // passes over the points, the scatter keeps the points of a cell in
+    // index order.
+    const std::size_t num_cells = m_columns * m_rows;
+
+    m_cell_start.assign(num_cells + 1, 0);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ++m_cell_start[m_cell_of[i] + 1];
+    }
+
+    for (std::size_t cell = 0; cell < num_cells; ++cell)
+    {
+        m_cell_start[cell + 1] += m_cell_start[cell];
+    }
+
+    m_indices.resize(count);
+
+    // the end of every cell ends up at its start again, m_cell_start is
+    // shifted by one cell while it serves as the write cursor
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        m_indices[m_cell_start[m_cell_of[i]]++] = static_cast<std::uint32_t>(i);
+    }
+
+    for (std::size_t cell = num_cells; cell > 0; --cell)
+    {
+        m_cell_start[cell] = m_cell_start[cell - 1];
+    }
+
+    m_cell_start[0] = 0;
+}
+
+std::size_t ParticleCollider::collide(std::vector<sf::Vector2f>& position,
+                                      std::vector<sf::Vector2f>& velocity,
+                                      std::size_t count,
+                                      float radius,
+                                      WorkerPool* pool)
+{
+    const float       diameter  = 2.f * radius;
+    const float       diameter2 = diameter * diameter;
+    const std::size_t alignment = WorkerPool::cache_line_elements(sizeof(sf::Vector2f));
+
+    if (count < 2 || radius <= 0.f)
+    {
+        return 0;
+    }
+
+    m_grid.build(position.data(), count, diameter, pool);
+
+    m_position.resize(count);
+    m_velocity.resize(count);
+    m_contacts.assign(pool ? pool->size() : 1, 0);
+
+    const std::vector<std::uint32_t>& sorted = m_grid.sorted_indices();
+
+    // particles are visited in cell order, so neighbouring particles read
+    // the same few cells while they are still in the cache
+    run_chunks(pool, count, alignment, [&](std::size_t chunk, std::size_t begin, std::size_t end)
+    {
+        std::size_t contacts = 0;
+
+        for (std::size_t k = begin; k < end; ++k)
+        {
+            const std::uint32_t i  = sorted[k];
+            const sf::Vector2f  pi = position[i];
+            const sf::Vector2f  vi = velocity[i];
+
+            sf::Vector2f dp(0.f, 0.f);
+            sf::Vector2f dv(0.f, 0.f);
+
+            m_grid.for_each_neighbour(pi, [&](std::uint32_t j)
+            {
+                const sf::Vector2f d  = position[j] - pi;
+                const float        d2 = d.x * d.x + d.y * d.y;
+
+                // discs exactly on top of each other have no normal, they
+                // separate once their velocities differ
+                if (j == i || d2 >= diameter2 || d2 == 0.f)
+                {
+                    return;
+                }
+
+                const float        distance = std::sqrt(d2);
+                const sf::Vector2f normal   = d / distance;
+
+                // half of the overlap, the other particle moves the other half
+                dp -= normal * (0.5f * (diameter - distance));
+
+                // equal masses swap the normal components of their velocities
+                const sf::Vector2f relative = velocity[j] - vi;
+                const float        approach = relative.x * normal.x + relative.y * normal.y;
+
+                if (approach < 0.f)
+                {
+                    dv += normal * approach;
+                }
+
+                ++contacts;
+            });
+
+            m_position[i] = pi + dp;
+            m_velocity[i] = vi + dv;
+        }
+
+        m_contacts[chunk] = contacts;
+    });
+
+    run_chunks(pool, count, alignment, [&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        std::copy(m_position.begin() + begin, m_position.begin() + end, position.begin() + begin);
+        std::copy(m_velocity.begin() + begin, m_velocity.begin() + end, velocity.begin() + begin);
+    });
+
+    std::size_t contacts = 0;
+
+    for (std::size_t chunk_contacts : m_contacts)
+    {
+        contacts += chunk_contacts;
+    }
+
+    // every contact was counted by both particles
+    return contacts / 2;
+}
+
+const SpatialGrid& ParticleCollider::grid() const
+{
+    return m_grid;
+}
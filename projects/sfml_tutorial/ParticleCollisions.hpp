@@ -0,0 +1,98 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "WorkerPool.hpp"
+
+// uniform grid over a set of points, rebuilt from scratch every frame with a
+// counting sort: the indices of the points are stored cell after cell in one
+// array and every cell is a range of it, so a rebuild only refills arrays
+// that keep their capacity and never allocates per cell
+class SpatialGrid
+{
+public:
+    SpatialGrid();
+
+    // bins points [0, count). cells are at least `cell_size` wide; sparse
+    // sets get wider cells so the grid never has many more cells than points.
+    void build(const sf::Vector2f* positions, std::size_t count, float cell_size, WorkerPool* pool);
+
+    // calls visit(index) for every point in the cell of `position` and the
+    // eight around it, which covers every point within cell_size()
+    template <typename Visit>
+    void for_each_neighbour(sf::Vector2f position, Visit visit) const
+    {
+        const long cx = cell_coordinate(position.x - m_origin.x);
+        const long cy = cell_coordinate(position.y - m_origin.y);
+
+        for (long y = std::max(cy - 1, 0L); y <= std::min(cy + 1, static_cast<long>(m_rows) - 1); ++y)
+        {
+            for (long x = std::max(cx - 1, 0L); x <= std::min(cx + 1, static_cast<long>(m_columns) - 1); ++x)
+            {
+                const std::size_t cell = static_cast<std::size_t>(y) * m_columns + static_cast<std::size_t>(x);
+
+                for (std::uint32_t k = m_cell_start[cell]; k < m_cell_start[cell + 1]; ++k)
+                {
+                    visit(m_indices[k]);
+                }
+            }
+        }
+    }
+
+    float cell_size() const;
+    std::size_t num_cells() const;
+
+    // the points in cell order: neighbours in space are close in this order
+    const std::vector<std::uint32_t>& sorted_indices() const;
+
+private:
+    long cell_coordinate(float offset) const;
+
+    sf::Vector2f m_origin;
+    float        m_cell_size;
+    float        m_inv_cell_size;
+    std::size_t  m_columns;
+    std::size_t  m_rows;
+
+    std::vector<std::uint32_t> m_cell_of;    // cell of every point
+    std::vector<std::uint32_t> m_cell_start; // first sorted index of every cell, plus the end
+    std::vector<std::uint32_t> m_indices;    // point indices sorted by cell
+
+    // per chunk of the worker pool
+    std::vector<sf::Vector2f> m_chunk_min;
+    std::vector<sf::Vector2f> m_chunk_max;
+};
+
+// elastic collisions between equal discs. every particle gathers the
+// response from all the discs it overlaps using the positions and
+// velocities of the frame before, so particles are independent and the
+// pass runs in parallel without locks. each pair is seen from both sides
+// with opposite normals, which keeps the total momentum unchanged.
+class ParticleCollider
+{
+public:
+    // resolves overlaps between particles [0, count) of the given radius:
+    // overlapping discs are pushed apart and approaching ones exchange the
+    // normal component of their velocities. returns the number of contacts.
+    std::size_t collide(std::vector<sf::Vector2f>& position,
+                        std::vector<sf::Vector2f>& velocity,
+                        std::size_t count,
+                        float radius,
+                        WorkerPool* pool);
+
+    // the grid of the last collide(), also usable for other neighbour queries
+    const SpatialGrid& grid() const;
+
+private:
+    SpatialGrid m_grid;
+
+    // the state after the pass, copied back once every particle is done
+    std::vector<sf::Vector2f> m_position;
+    std::vector<sf::Vector2f> m_velocity;
+    std::vector<std::size_t>  m_contacts; // per chunk
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+// emitter model shared by the particle classes: turns an emission rate and
+// requested bursts into a whole number of particles to spawn each frame.
+// a negative rate means the legacy mode where every particle stays alive
+// and is respawned in place.
+class ParticleEmission
+{
+public:
+    ParticleEmission()
+    : m_rate(-1.f),
+      m_accumulator(0.f),
+      m_burst(0)
+    {}
+
+    void set_rate(float particles_per_second)
+    {
+        m_rate        = particles_per_second;
+        m_accumulator = 0.f;
+    }
+
+    float rate() const
+    {
+        return m_rate;
+    }
+
+    bool continuous() const
+    {
+        return m_rate < 0.f;
+    }
+
+    void burst(std::size_t count)
+    {
+        m_burst += count;
+    }
+
+    // particles to spawn after dt seconds; whatever does not fit into the
+    // free slots is dropped rather than queued
+    std::size_t advance(float dt, std::size_t free_slots)
+    {
+        m_accumulator += std::max(m_rate, 0.f) * dt;
+
+        std::size_t count = static_cast<std::size_t>(m_accumulator);
+        m_accumulator -= static_cast<float>(count);
+
+        count  += m_burst;
+        m_burst = 0;
+
+        return std::min(count, free_slots);
+    }
+
+private:
+    float       m_rate;
+    float       m_accumulator;
+    std::size_t m_burst;
+};
@@ -0,0 +1,191 @@
+#include "ParticleFrame.hpp"
+
+#include <algorithm>
+
+ParticleFrame::ParticleFrame()
+: particles(0),
+  stride(1),
+  shader(nullptr),
+  step(0.f),
+  update_time(sf::Time::Zero),
+  build_time(sf::Time::Zero),
+  m_alpha(1.f),
+  m_stamped(false),
+  m_ring(nullptr)
+{}
+
+void ParticleFrame::reset(sf::PrimitiveType primitive, std::size_t count, std::size_t vertices_per_particle)
+{
+    particles = count;
+    stride    = vertices_per_particle;
+
+    // both keep their capacity, a frame stops allocating once it has seen
+    // the largest live count
+    vertices.setPrimitiveType(primitive);
+    vertices.resize(count * stride);
+    velocity.resize(count);
+}
+
+void ParticleFrame::set_alpha(float alpha)
+{
+    m_alpha = std::min(std::max(alpha, 0.f), 1.f);
+}
+
+float ParticleFrame::alpha() const
+{
+    return m_alpha;
+}
+
+void ParticleFrame::use_vertex_ring(VertexRing* ring)
+{
+    m_ring = ring;
+}
+
+void ParticleFrame::set_stamp(const sf::CircleShape* shape)
+{
+    m_stamped = shape != nullptr;
+
+    if (m_stamped)
+    {
+        m_stamp = *shape;
+    }
+}
+
+void ParticleFrame::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    const std::size_t count = particles * stride;
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    states.transform *= transform;
+    states.texture    = NULL;
+    states.shader     = shader;
+
+    // one draw call per particle, like the particle class draws its shapes
+    if (m_stamped)
+    {
+        const float back = m_alpha < 1.f ? (1.f - m_alpha) * step : 0.f;
+
+        for (std::size_t i = 0; i < particles; ++i)
+        {
+            m_stamp.setPosition(vertices[i].position - velocity[i] * back);
+            m_stamp.setFillColor(vertices[i].color);
+            target.draw(m_stamp, states);
+        }
+
+        return;
+    }
+
+    const sf::Vertex* source = &vertices[0];
+
+    if (m_alpha < 1.f && step > 0.f)
+    {
+        // every vertex of a particle moves with the particle
+        const float back = (1.f - m_alpha) * step;
+
+        m_blended.resize(count);
+
+        for (std::size_t i = 0; i < particles; ++i)
+        {
+            const sf::Vector2f offset = velocity[i] * back;
+
+            for (std::size_t j = i * stride; j < (i + 1) * stride; ++j)
+            {
+                m_blended[j]           = vertices[j];
+                m_blended[j].position -= offset;
+            }
+        }
+
+        source = m_blended.data();
+    }
+
+    if (m_ring == nullptr || m_ring->empty())
+    {
+        target.draw(source, count, vertices.getPrimitiveType(), states);
+        return;
+    }
+
+    m_ring->draw(target, source, count, vertices.getPrimitiveType(), states);
+}
+
+VertexRing::VertexRing()
+: m_front(0),
+  m_fastest_upload(0.f)
+{}
+
+bool VertexRing::create(unsigned int ring_size)
+{
+    m_buffers.clear();
+    m_front          = 0;
+    m_stats          = UploadStats();
+    m_fastest_upload = 0.f;
+
+    if (ring_size == 0 || !sf::VertexBuffer::isAvailable())
+    {
+        return false;
+    }
+
+    // the buffers are sized by the first frames drawn through them
+    m_buffers.resize(ring_size);
+
+    for (sf::VertexBuffer& buffer : m_buffers)
+    {
+        buffer.setUsage(sf::VertexBuffer::Stream);
+    }
+
+    return true;
+}
+
+bool VertexRing::empty() const
+{
+    return m_buffers.empty();
+}
+
+const UploadStats& VertexRing::stats() const
+{
+    return m_stats;
+}
+
+void VertexRing::draw(sf::RenderTarget& target,
+                      const sf::Vertex* vertices,
+                      std::size_t count,
+                      sf::PrimitiveType primitive,
+                      const sf::RenderStates& states)
+{
+    // write the next buffer in the ring, the GPU may still be reading the current one
+    const std::size_t back   = (m_front + 1) % m_buffers.size();
+    sf::VertexBuffer& buffer = m_buffers[back];
+
+    // a buffer grows to the largest frame drawn through it
+    if (buffer.getVertexCount() < count && !buffer.create(count))
+    {
+        target.draw(vertices, count, primitive, states);
+        return;
+    }
+
+    sf::Clock timer;
+    buffer.update(vertices, count, 0);
+    const sf::Time upload = timer.getElapsedTime();
+
+    m_front = back;
+
+    // uploads shrink and grow with the live count, so the fastest rate seen is
+    // the copy cost and anything above it is time spent waiting on the driver
+    const float per_vertex = upload.asSeconds() / count;
+
+    if (m_stats.uploads == 0 || per_vertex < m_fastest_upload)
+    {
+        m_fastest_upload = per_vertex;
+    }
+
+    m_stats.uploads     += 1;
+    m_stats.bytes       += count * sizeof(sf::Vertex);
+    m_stats.upload_time += upload;
+    m_stats.stall_time  += upload - sf::seconds(m_fastest_upload * count);
+
+    buffer.setPrimitiveType(primitive);
+    target.draw(buffer, 0, count, states);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// counters of a VertexRing
+struct UploadStats
+{
+    std::size_t   uploads = 0;
+    std::uint64_t bytes   = 0;
+    sf::Time      upload_time; // total time spent in buffer updates
+    sf::Time      stall_time;  // the part of each update above the fastest one seen
+
+    // bytes per second
+    double bandwidth() const
+    {
+        return upload_time > sf::Time::Zero ? bytes / upload_time.asSeconds() : 0.0;
+    }
+};
+
+// a ring of streaming GPU buffers owned by the render thread. every draw
+// fills the buffer after the one drawn last, so the CPU never overwrites a
+// buffer the GPU may still be reading for an earlier draw, even when the
+// same frame is drawn again faster than new frames arrive.
+class VertexRing
+{
+public:
+    VertexRing();
+
+    // needs an active OpenGL context; returns false and stays empty if
+    // buffers are not available
+    bool create(unsigned int ring_size = 3);
+    bool empty() const;
+
+    // uploads `count` vertices into the next buffer and draws it
+    void draw(sf::RenderTarget& target,
+              const sf::Vertex* vertices,
+              std::size_t count,
+              sf::PrimitiveType primitive,
+              const sf::RenderStates& states);
+
+    const UploadStats& stats() const;
+
+private:
+    std::vector<sf::VertexBuffer> m_buffers;
+    std::size_t                   m_front;
+    UploadStats                   m_stats;
+    float                         m_fastest_upload; // seconds per vertex
+};
+
+// what a particle class draws, copied out after a simulation step so that
+// another thread can draw it while the next step runs. particles move in a
+// straight line during a step, so a frame can also be drawn anywhere between
+// the step before and its own: a vertex of particle i is drawn at
+//   position - velocity[i] * step * (1 - alpha)
+class ParticleFrame : public sf::Drawable
+{
+public:
+    sf::VertexArray           vertices;  // at the end of the step, `stride` per particle
+    std::vector<sf::Vector2f> velocity;  // per particle
+    std::size_t               particles; // live particles
+    std::size_t               stride;
+    const sf::Shader*         shader;    // owned by the particle class, null for none
+    sf::Transform             transform;
+    float                     step;      // seconds of the step that produced the frame
+
+    // filled by whoever produces the frames
+    sf::Time  update_time; // wall time of the steps behind this frame
+    sf::Time  build_time;  // wall time of copying the particles into it
+    sf::Clock published;   // restarted when the frame is handed over
+
+    ParticleFrame();
+
+    // sizes the frame for `count` particles of `stride` vertices each
+    void reset(sf::PrimitiveType primitive, std::size_t count, std::size_t vertices_per_particle);
+
+    // 1 draws the state at the end of the step, 0 the state one step before
+    void  set_alpha(float alpha);
+    float alpha() const;
+
+    // draw through a ring of the render thread instead of the client-side
+    // array, null goes back to the array. frames drawn by the same thread
+    // share one ring.
+    void use_vertex_ring(VertexRing* ring);
+
+    // draw a copy of `shape` once per particle, one draw call each, instead
+    // of the vertices, which then hold one point per particle with its
+    // position and colour. null goes back to drawing the vertices.
+    void set_stamp(const sf::CircleShape* shape);
+
+private:
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+
+    float m_alpha;
+
+    // the shape set_stamp() copied, moved around by draw()
+    mutable sf::CircleShape m_stamp;
+    bool                    m_stamped;
+
+    // scratch of the render thread: the interpolated vertices
+    mutable std::vector<sf::Vertex> m_blended;
+    VertexRing*                     m_ring;
+};
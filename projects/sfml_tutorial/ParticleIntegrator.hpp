@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ParticleStore.hpp"
+
+// how a particle class respawns: a dead particle restarts at the emitter in
+// a random direction with a speed in [speed_min, speed_max) and a lifetime
+// in [lifetime_min, lifetime_max) seconds
+struct SpawnParams
+{
+    sf::Vector2f emitter;
+    float        speed_min;
+    float        speed_max;
+    float        lifetime_min;
+    float        lifetime_max;
+    float        inv_lifetime; // alpha = lifetime * inv_lifetime * 255
+};
+
+// backend that advances a whole particle store somewhere else than the CPU
+// kernel, e.g. on an OpenCL device. one call does the work of
+// integrate_particles() and the respawn pass: particles [0, store.live) are
+// advanced by dt and the ones that die are respawned in place. a respawn
+// keeps the RGB bytes of the colour and only sets its alpha.
+class ParticleIntegrator
+{
+public:
+    virtual ~ParticleIntegrator() {}
+
+    virtual void integrate(ParticleStore& store, float dt, const SpawnParams& spawn) = 0;
+};
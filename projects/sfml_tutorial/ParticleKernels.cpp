@@ -0,0 +1,275 @@
+#include "ParticleKernels.hpp"
+#include "ParticleStore.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PARTICLE_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(PARTICLE_KERNELS_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// gcc and clang only emit AVX2 instructions inside functions marked for it,
+// which keeps the rest of the binary runnable on older CPUs
+#if defined(PARTICLE_KERNELS_X86) && !defined(_MSC_VER)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+static_assert(sizeof(sf::Color) == sizeof(std::uint32_t), "colours are processed as packed RGBA words");
+static_assert(sizeof(sf::Vector2f) == 2 * sizeof(float), "positions are processed as interleaved x, y floats");
+
+// the alpha channel is the top byte of a little-endian RGBA word
+static const std::uint32_t RGB_MASK = 0x00FFFFFFu;
+
+static KernelArgs make_args(ParticleStore& store, float dt, float inv_lifetime)
+{
+    KernelArgs args;
+    args.lifetime    = store.lifetime.data();
+    args.position    = reinterpret_cast<float*>(store.position.data());
+    args.velocity    = reinterpret_cast<const float*>(store.velocity.data());
+    args.color       = reinterpret_cast<std::uint32_t*>(store.color.data());
+    args.dt          = dt;
+    args.alpha_scale = inv_lifetime * 255.f;
+    return args;
+}
+
+static void append_dead(int mask, std::size_t first, std::vector<std::uint32_t>& dead)
+{
+    for (std::uint32_t k = 0; mask != 0; ++k, mask >>= 1)
+    {
+        if (mask & 1)
+        {
+            dead.push_back(static_cast<std::uint32_t>(first) + k);
+        }
+    }
+}
+
+static void integrate_scalar(const KernelArgs& args,
+                             std::size_t begin,
+                             std::size_t end,
+                             std::vector<std::uint32_t>& dead)
+{
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        float lifetime   = args.lifetime[i] - args.dt;
+        args.lifetime[i] = lifetime;
+
+        args.position[2 * i]     += args.velocity[2 * i] * args.dt;
+        args.position[2 * i + 1] += args.velocity[2 * i + 1] * args.dt;
+
+        float alpha   = std::min(std::max(lifetime * args.alpha_scale, 0.f), 255.f);
+        args.color[i] = (args.color[i] & RGB_MASK) | (static_cast<std::uint32_t>(alpha) << 24);
+
+        if (lifetime <= 0.f)
+        {
+            dead.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+}
+
+#ifdef PARTICLE_KERNELS_X86
+
+TARGET_SSE2
+static void integrate_sse2(const KernelArgs& args,
+                           std::size_t begin,
+                           std::size_t end,
+                           std::vector<std::uint32_t>& dead)
+{
+    const __m128  dt       = _mm_set1_ps(args.dt);
+    const __m128  scale    = _mm_set1_ps(args.alpha_scale);
+    const __m128  zero     = _mm_setzero_ps();
+    const __m128  max      = _mm_set1_ps(255.f);
+    const __m128i rgb_mask = _mm_set1_epi32(static_cast<int>(RGB_MASK));
+
+    std::size_t i = begin;
+
+    for (; i + 4 <= end; i += 4)
+    {
+        // lifetime
+        __m128 lifetime = _mm_sub_ps(_mm_loadu_ps(args.lifetime + i), dt);
+        _mm_storeu_ps(args.lifetime + i, lifetime);
+
+        // 4 particles are 8 interleaved position floats
+        float*       position = args.position + 2 * i;
+        const float* velocity = args.velocity + 2 * i;
+
+        _mm_storeu_ps(position,     _mm_add_ps(_mm_loadu_ps(position),     _mm_mul_ps(_mm_loadu_ps(velocity),     dt)));
+        _mm_storeu_ps(position + 4, _mm_add_ps(_mm_loadu_ps(position + 4), _mm_mul_ps(_mm_loadu_ps(velocity + 4), dt)));
+
+        // alpha goes into the top byte of each colour word
+        __m128  alpha = _mm_min_ps(_mm_max_ps(_mm_mul_ps(lifetime, scale), zero), max);
+        __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(args.color + i));
+        color = _mm_or_si128(_mm_and_si128(color, rgb_mask), _mm_slli_epi32(_mm_cvttps_epi32(alpha), 24));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(args.color + i), color);
+
+        append_dead(_mm_movemask_ps(_mm_cmple_ps(lifetime, zero)), i, dead);
+    }
+
+    integrate_scalar(args, i, end, dead);
+}
+
+TARGET_AVX2
+static void integrate_avx2(const KernelArgs& args,
+                           std::size_t begin,
+                           std::size_t end,
+                           std::vector<std::uint32_t>& dead)
+{
+    const __m256  dt       = _mm256_set1_ps(args.dt);
+    const __m256  scale    = _mm256_set1_ps(args.alpha_scale);
+    const __m256  zero     = _mm256_setzero_ps();
+    const __m256  max      = _mm256_set1_ps(255.f);
+    const __m256i rgb_mask = _mm256_set1_epi32(static_cast<int>(RGB_MASK));
+
+    std::size_t i = begin;
+
+    for (; i + 8 <= end; i += 8)
+    {
+        // lifetime
+        __m256 lifetime = _mm256_sub_ps(_mm256_loadu_ps(args.lifetime + i), dt);
+        _mm256_storeu_ps(args.lifetime + i, lifetime);
+
+        // 8 particles are 16 interleaved position floats
+        float*       position = args.position + 2 * i;
+        const float* velocity = args.velocity + 2 * i;
+
+        _mm256_storeu_ps(position,     _mm256_add_ps(_mm256_loadu_ps(position),     _mm256_mul_ps(_mm256_loadu_ps(velocity),     dt)));
+        _mm256_storeu_ps(position + 8, _mm256_add_ps(_mm256_loadu_ps(position + 8), _mm256_mul_ps(_mm256_loadu_ps(velocity + 8), dt)));
+
+        // alpha goes into the top byte of each colour word
+        __m256  alpha = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(lifetime, scale), zero), max);
+        __m256i color = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(args.color + i));
+        color = _mm256_or_si256(_mm256_and_si256(color, rgb_mask), _mm256_slli_epi32(_mm256_cvttps_epi32(alpha), 24));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(args.color + i), color);
+
+        append_dead(_mm256_movemask_ps(_mm256_cmp_ps(lifetime, zero, _CMP_LE_OQ)), i, dead);
+    }
+
+    integrate_scalar(args, i, end, dead);
+}
+
+#endif // PARTICLE_KERNELS_X86
+
+static KernelIsa detect_isa()
+{
+#ifdef PARTICLE_KERNELS_X86
+    bool sse2 = false;
+    bool avx2 = false;
+
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    sse2 = (info[3] & (1 << 26)) != 0;
+
+    // AVX2 also needs the OS to save the upper halves of the ymm registers
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx     = (info[2] & (1 << 28)) != 0;
+
+    if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    sse2 = __builtin_cpu_supports("sse2");
+    avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    if (avx2)
+    {
+        return KernelIsa::AVX2;
+    }
+
+    if (sse2)
+    {
+        return KernelIsa::SSE2;
+    }
+#endif
+
+    return KernelIsa::Scalar;
+}
+
+KernelIsa particle_kernel_isa()
+{
+    static const KernelIsa isa = detect_isa();
+    return isa;
+}
+
+const char* to_string(KernelIsa isa)
+{
+    switch (isa)
+    {
+        case KernelIsa::AVX2: return "AVX2";
+        case KernelIsa::SSE2: return "SSE2";
+        default:              return "scalar";
+    }
+}
+
+void integrate_particles(ParticleStore& store,
+                         std::size_t begin,
+                         std::size_t end,
+                         float dt,
+                         float inv_lifetime,
+                         std::vector<std::uint32_t>& dead)
+{
+    integrate_particles(particle_kernel_isa(), store, begin, end, dt, inv_lifetime, dead);
+}
+
+void integrate_particles(KernelIsa isa,
+                         ParticleStore& store,
+                         std::size_t begin,
+                         std::size_t end,
+                         float dt,
+                         float inv_lifetime,
+                         std::vector<std::uint32_t>& dead)
+{
+    integrate_particles(isa, make_args(store, dt, inv_lifetime), begin, end, dead);
+}
+
+void integrate_particles(const KernelArgs& args,
+                         std::size_t begin,
+                         std::size_t end,
+                         std::vector<std::uint32_t>& dead)
+{
+    integrate_particles(particle_kernel_isa(), args, begin, end, dead);
+}
+
+void integrate_particles(KernelIsa isa,
+                         const KernelArgs& args,
+                         std::size_t begin,
+                         std::size_t end,
+                         std::vector<std::uint32_t>& dead)
+{
+    // never run an instruction set the CPU does not have
+    if (static_cast<int>(isa) > static_cast<int>(particle_kernel_isa()))
+    {
+        isa = particle_kernel_isa();
+    }
+
+#ifdef PARTICLE_KERNELS_X86
+    if (isa == KernelIsa::AVX2)
+    {
+        integrate_avx2(args, begin, end, dead);
+        return;
+    }
+
+    if (isa == KernelIsa::SSE2)
+    {
+        integrate_sse2(args, begin, end, dead);
+        return;
+    }
+#endif
+
+    integrate_scalar(args, begin, end, dead);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ParticleRandom.hpp"
+
+struct ParticleStore;
+
+enum class KernelIsa
+{
+    Scalar,
+    SSE2, // 4 particles per instruction
+    AVX2  // 8 particles per instruction
+};
+
+// per worker-chunk scratch for the integration kernel, padded to a cache line
+struct alignas(64) KernelChunk
+{
+    ParticleRandom             rng;
+    std::vector<std::uint32_t> dead;
+};
+
+// the arrays and constants of one kernel call, for callers that keep their
+// particles outside a ParticleStore in the same layout
+struct KernelArgs
+{
+    float*         lifetime;
+    float*         position; // interleaved x, y
+    const float*   velocity; // interleaved x, y
+    std::uint32_t* color;    // packed RGBA, alpha in the top byte
+    float          dt;
+    float          alpha_scale; // inv_lifetime * 255
+};
+
+// the widest instruction set supported by the running CPU, detected once
+KernelIsa particle_kernel_isa();
+
+const char* to_string(KernelIsa isa);
+
+// advances particles [begin, end) of the store by dt:
+//   lifetime -= dt, position += velocity * dt, alpha = lifetime * inv_lifetime * 255
+// the kernel never branches on a particle; the indices of particles whose
+// lifetime ran out are appended to `dead` in ascending order so the caller
+// can respawn them in a separate pass
+void integrate_particles(ParticleStore& store,
+                         std::size_t begin,
+                         std::size_t end,
+                         float dt,
+                         float inv_lifetime,
+                         std::vector<std::uint32_t>& dead);
+
+// same as above with an explicit instruction set, used to compare the paths
+void integrate_particles(KernelIsa isa,
+                         ParticleStore& store,
+                         std::size_t begin,
+                         std::size_t end,
+                         float dt,
+                         float inv_lifetime,
+                         std::vector<std::uint32_t>& dead);
+
+// same as above on raw arrays
+void integrate_particles(const KernelArgs& args,
+                         std::size_t begin,
+                         std::size_t end,
+                         std::vector<std::uint32_t>& dead);
+
+void integrate_particles(KernelIsa isa,
+                         const KernelArgs& args,
+                         std::size_t begin,
+                         std::size_t end,
+                         std::vector<std::uint32_t>& dead);
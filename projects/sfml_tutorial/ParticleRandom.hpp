@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// counter-based random generator: the n-th number of a stream is a hash of
+// (key, n), so a stream is two integers, owns no global state and is fully
+// reproducible from its seed and stream index
+class ParticleRandom
+{
+public:
+    explicit ParticleRandom(std::uint64_t seed = 0, std::uint64_t stream = 0)
+    : m_key(mix(seed ^ mix(stream + GOLDEN_GAMMA))),
+      m_counter(0)
+    {}
+
+    std::uint32_t next_u32()
+    {
+        return static_cast<std::uint32_t>(next_u64() >> 32);
+    }
+
+    // uniform in [0, 1)
+    float next_float()
+    {
+        return static_cast<float>(next_u64() >> 40) * (1.f / 16777216.f);
+    }
+
+    // uniform in [lo, hi)
+    float uniform(float lo, float hi)
+    {
+        return lo + (hi - lo) * next_float();
+    }
+
+    // fills out[0..count) with uniforms in [0, 1)
+    void fill_uniform(float* out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out[i] = static_cast<float>(mix(m_key + (m_counter + i + 1) * GOLDEN_GAMMA) >> 40) * (1.f / 16777216.f);
+        }
+
+        m_counter += count;
+    }
+
+    // positions the stream so that the next number drawn is number counter + 1,
+    // which lets other devices draw the same numbers without replaying the stream
+    void seek(std::uint64_t counter)
+    {
+        m_counter = counter;
+    }
+
+    // splitmix64 finalizer
+    static std::uint64_t mix(std::uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    static const std::uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ull;
+
+    std::uint64_t next_u64()
+    {
+        return mix(m_key + (++m_counter) * GOLDEN_GAMMA);
+    }
+
+    std::uint64_t m_key;
+    std::uint64_t m_counter;
+};
@@ -0,0 +1,243 @@
+#include "ParticleSimulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static const float TWO_PI = 6.28318531f;
+
+ParticleSimulation::ParticleSimulation(std::size_t count,
+                                       const SpawnParams& spawn,
+                                       const std::vector<sf::Color>& palette,
+                                       std::size_t grain)
+: m_store(count),
+  m_spawn(spawn),
+  m_palette(palette),
+  m_pool(nullptr),
+  m_grain(grain),
+  m_integrator(nullptr),
+  m_collision_radius(0.f),
+  m_contacts(0)
+{
+    set_worker_pool(nullptr);
+}
+
+void ParticleSimulation::reset_particle(std::size_t index, ParticleRandom& rng)
+{
+    // draw all random numbers for this particle at once
+    float u[6];
+    rng.fill_uniform(u, m_palette.empty() ? 6 : 3);
+
+    // give random velocity and lifetime to the particle
+    float angle = u[0] * TWO_PI;
+    float speed = m_spawn.speed_min + (m_spawn.speed_max - m_spawn.speed_min) * u[1];
+    m_store.velocity[index] = sf::Vector2f(std::cos(angle) * speed, std::sin(angle) * speed);
+    m_store.lifetime[index] = m_spawn.lifetime_min + (m_spawn.lifetime_max - m_spawn.lifetime_min) * u[2];
+
+    // restart from the emitter with the alpha matching the new lifetime
+    float ratio = std::min(m_store.lifetime[index] * m_spawn.inv_lifetime, 1.f);
+    m_store.position[index] = m_spawn.emitter;
+
+    if (m_palette.empty())
+    {
+        m_store.color[index] = sf::Color(static_cast<sf::Uint8>(u[3] * 255),
+                                         static_cast<sf::Uint8>(u[4] * 255),
+                                         static_cast<sf::Uint8>(u[5] * 255));
+    }
+    else
+    {
+        m_store.color[index] = m_palette[index % m_palette.size()];
+    }
+
+    m_store.color[index].a = static_cast<sf::Uint8>(ratio * 255);
+}
+
+void ParticleSimulation::set_emitter(sf::Vector2f position)
+{
+    m_spawn.emitter = position;
+}
+
+void ParticleSimulation::set_worker_pool(WorkerPool* pool, unsigned int seed)
+{
+    m_pool = pool;
+    m_chunks.assign(pool ? pool->size() : 1, KernelChunk());
+
+    for (std::size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        m_chunks[i].rng = ParticleRandom(seed, i);
+    }
+}
+
+void ParticleSimulation::set_integrator(ParticleIntegrator* integrator)
+{
+    m_integrator = integrator;
+
+    // a backend only rewrites the alpha byte when it respawns a particle, so
+    // every slot gets the colour reset_particle would give it up front
+    if (integrator != nullptr)
+    {
+        m_store.seed_colors(m_palette);
+    }
+}
+
+bool ParticleSimulation::offloaded() const
+{
+    return m_integrator != nullptr && m_emission.continuous();
+}
+
+void ParticleSimulation::set_emission_rate(float rate)
+{
+    // going back to continuous respawning brings every free slot back to life
+    if (rate < 0.f && !m_emission.continuous())
+    {
+        const std::size_t first_free = m_store.live;
+        m_store.live = m_store.size();
+
+        for (std::size_t i = first_free; i < m_store.size(); ++i)
+        {
+            reset_particle(i, m_chunks[0].rng);
+        }
+
+        write_vertices(first_free, m_store.size());
+    }
+
+    m_emission.set_rate(rate);
+}
+
+void ParticleSimulation::emit(std::size_t count)
+{
+    m_emission.burst(count);
+}
+
+void ParticleSimulation::set_collision_radius(float radius)
+{
+    m_collision_radius = std::max(radius, 0.f);
+    m_contacts         = 0;
+}
+
+std::size_t ParticleSimulation::contacts() const
+{
+    return m_contacts;
+}
+
+std::size_t ParticleSimulation::live_particles() const
+{
+    return m_store.live;
+}
+
+std::size_t ParticleSimulation::capacity() const
+{
+    return m_store.size();
+}
+
+void ParticleSimulation::parallel_for(std::size_t count, const WorkerPool::Task& task) const
+{
+    if (m_pool == nullptr)
+    {
+        task(0, 0, count);
+    }
+    else
+    {
+        m_pool->parallel_for(count, m_grain, task);
+    }
+}
+
+void ParticleSimulation::update(sf::Time elapsed)
+{
+    const float dt = elapsed.asSeconds();
+
+    // chunks left without work keep no dead indices from the previous frame
+    for (KernelChunk& chunk : m_chunks)
+    {
+        chunk.dead.clear();
+    }
+
+    // the backend advances the whole store at once, the chunks then only
+    // mirror it into the vertices
+    if (offloaded())
+    {
+        m_integrator->integrate(m_store, dt, m_spawn);
+    }
+
+    parallel_for(m_store.live, [&](std::size_t chunk, std::size_t begin, std::size_t end)
+    {
+        update_range(begin, end, dt, m_chunks[chunk]);
+    });
+
+    // the emitter model compacts and refills the store on the calling thread
+    if (!m_emission.continuous())
+    {
+        remove_dead();
+        spawn_particles(dt);
+    }
+
+    // collisions need every particle in its new place, the vertices follow
+    if (m_collision_radius > 0.f)
+    {
+        collide();
+    }
+}
+
+void ParticleSimulation::update_range(std::size_t begin, std::size_t end, float dt, KernelChunk& chunk)
+{
+    if (!offloaded())
+    {
+        // branch-free pass: lifetime, position and alpha for the whole range
+        integrate_particles(m_store, begin, end, dt, m_spawn.inv_lifetime, chunk.dead);
+
+        // compacted pass: respawn only the particles that died this frame
+        if (m_emission.continuous())
+        {
+            for (std::uint32_t index : chunk.dead)
+            {
+                reset_particle(index, chunk.rng);
+            }
+        }
+    }
+
+    // with collisions the vertices are written after the collision stage
+    if (m_collision_radius <= 0.f)
+    {
+        write_vertices(begin, end);
+    }
+}
+
+void ParticleSimulation::collide()
+{
+    m_contacts = m_collider.collide(m_store.position, m_store.velocity, m_store.live, m_collision_radius, m_pool);
+
+    parallel_for(m_store.live, [&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        write_vertices(begin, end);
+    });
+}
+
+void ParticleSimulation::remove_dead()
+{
+    // chunks are in index order and each dead list is ascending, so walking
+    // both backwards removes in descending order and never moves a dead
+    // particle into a slot that is still to be visited
+    for (auto chunk = m_chunks.rbegin(); chunk != m_chunks.rend(); ++chunk)
+    {
+        for (auto index = chunk->dead.rbegin(); index != chunk->dead.rend(); ++index)
+        {
+            m_store.swap_remove(*index);
+
+            if (*index < m_store.live)
+            {
+                write_vertices(*index, *index + 1);
+            }
+        }
+    }
+}
+
+void ParticleSimulation::spawn_particles(float dt)
+{
+    const std::size_t count = m_emission.advance(dt, m_store.size() - m_store.live);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const std::size_t index = m_store.live++;
+        reset_particle(index, m_chunks[0].rng);
+        write_vertices(index, index + 1);
+    }
+}
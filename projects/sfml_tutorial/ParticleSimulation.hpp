@@ -0,0 +1,99 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+#include "ParticleCollisions.hpp"
+#include "ParticleEmission.hpp"
+#include "ParticleIntegrator.hpp"
+#include "ParticleKernels.hpp"
+#include "ParticleStore.hpp"
+#include "WorkerPool.hpp"
+
+// the simulation half of the particle classes: a particle store advanced by
+// the vectorized kernel or a backend, respawned in place or fed by an
+// emitter, optionally collided, and split over a worker pool. the classes
+// only decide how a particle turns into vertices; write_vertices() is called
+// for every range of particles that changed.
+class ParticleSimulation
+{
+public:
+    virtual ~ParticleSimulation() {}
+
+    void set_emitter(sf::Vector2f position);
+
+    // update on the given pool, or single-threaded if null. respawns are
+    // reproducible for a given seed and number of threads.
+    void set_worker_pool(WorkerPool* pool, unsigned int seed = 0);
+
+    // hand integration and respawning to another backend, or null for the
+    // CPU kernel. the backend is only used while particles respawn in place;
+    // the emitter model needs the dead lists of the CPU kernel.
+    void set_integrator(ParticleIntegrator* integrator);
+
+    // emitter model: spawn `rate` particles per second into the free slots of
+    // the pool and remove particles when they die. the pool size is the count
+    // given to the constructor. a negative rate goes back to respawning every
+    // particle in place, which is the default.
+    void set_emission_rate(float rate);
+
+    // spawns `count` particles at once on the next update (emitter model only)
+    void emit(std::size_t count);
+
+    // particles bounce off each other as discs of the given radius. 0 turns
+    // collisions off, the default.
+    void set_collision_radius(float radius);
+
+    // contacts resolved by the last update
+    std::size_t contacts() const;
+
+    std::size_t live_particles() const;
+    std::size_t capacity() const;
+
+    void update(sf::Time elapsed);
+
+protected:
+    // particle i respawns with palette[i % palette.size()], or with a random
+    // colour if the palette is empty. `grain` is the number of particles the
+    // chunks of a parallel pass are aligned to, see cache_line_elements().
+    ParticleSimulation(std::size_t count,
+                       const SpawnParams& spawn,
+                       const std::vector<sf::Color>& palette,
+                       std::size_t grain);
+
+    // mirrors particles [begin, end) of the store into the vertices. ranges
+    // of different chunks are written from different threads at once.
+    virtual void write_vertices(std::size_t begin, std::size_t end) = 0;
+
+    // runs `task` over [0, count) on the worker pool, or inline without one
+    void parallel_for(std::size_t count, const WorkerPool::Task& task) const;
+
+    ParticleStore m_store;
+
+private:
+    void reset_particle(std::size_t index, ParticleRandom& rng);
+    bool offloaded() const;
+    void update_range(std::size_t begin, std::size_t end, float dt, KernelChunk& chunk);
+    void remove_dead();
+    void spawn_particles(float dt);
+    void collide();
+
+    SpawnParams            m_spawn;
+    std::vector<sf::Color> m_palette;
+
+    // continuous respawn in place, or an emission rate over a pool of free slots
+    ParticleEmission m_emission;
+
+    // parallel update: one random stream and dead list per chunk of the worker pool
+    WorkerPool*              m_pool;
+    std::vector<KernelChunk> m_chunks;
+    std::size_t              m_grain;
+
+    // optional backend that replaces the CPU kernel, e.g. an OpenCL device
+    ParticleIntegrator* m_integrator;
+
+    // optional collision stage, off while the radius is 0
+    ParticleCollider m_collider;
+    float            m_collision_radius;
+    std::size_t      m_contacts;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+// structure-of-arrays particle state: every attribute lives in its own
+// contiguous array so that update loops stream through memory linearly
+struct ParticleStore
+{
+    std::vector<sf::Vector2f> position;
+    std::vector<sf::Vector2f> velocity;
+    std::vector<float>        lifetime; // remaining lifetime in seconds
+    std::vector<sf::Color>    color;
+
+    // particles [0, live) are alive, the rest of the capacity is free
+    std::size_t live;
+
+    explicit ParticleStore(std::size_t count = 0)
+    : live(0)
+    {
+        resize(count);
+    }
+
+    // every particle of a freshly resized store counts as alive
+    void resize(std::size_t count)
+    {
+        position.resize(count);
+        velocity.resize(count);
+        lifetime.resize(count, 0.f);
+        color.resize(count, sf::Color::White);
+        live = count;
+    }
+
+    std::size_t size() const
+    {
+        return lifetime.size();
+    }
+
+    // gives particle i the RGB of palette[i % palette.size()] and keeps its
+    // alpha. an empty palette leaves the colours alone.
+    void seed_colors(const std::vector<sf::Color>& palette)
+    {
+        if (palette.empty())
+        {
+            return;
+        }
+
+        for (std::size_t i = 0; i < color.size(); ++i)
+        {
+            const sf::Uint8 alpha = color[i].a;
+
+            color[i]   = palette[i % palette.size()];
+            color[i].a = alpha;
+        }
+    }
+
+    // moves the last live particle into `index` and shrinks the live range.
+    // removing in descending index order keeps every remaining index valid.
+    void swap_remove(std::size_t index)
+    {
+        const std::size_t last = --live;
+
+        position[index] = position[last];
+        velocity[index] = velocity[last];
+        lifetime[index] = lifetime[last];
+        color[index]    = color[last];
+    }
+};
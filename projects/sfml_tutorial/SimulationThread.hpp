@@ -0,0 +1,214 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FixedTimestep.hpp"
+#include "ParticleFrame.hpp"
+
+// three frames shared by one writer and one reader without locks. the
+// writer owns one frame to fill, the reader one to draw, and the third is
+// the newest complete frame. publishing and acquiring swap the owned frame
+// with the third, so the reader skips the frames a fast writer produces in
+// between and the writer never waits for a slow reader.
+template <typename Frame>
+class TripleBuffer
+{
+public:
+    TripleBuffer()
+    : m_write(0),
+      m_latest(1),
+      m_read(2)
+    {}
+
+    // writer side
+    Frame& write_frame()
+    {
+        return m_frames[m_write];
+    }
+
+    void publish()
+    {
+        m_write = m_latest.exchange(m_write | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // reader side: takes the newest frame if one was published since the
+    // last call, otherwise keeps the current one. returns true on a new frame.
+    bool acquire()
+    {
+        if ((m_latest.load(std::memory_order_relaxed) & FRESH) == 0)
+        {
+            return false;
+        }
+
+        m_read = m_latest.exchange(m_read, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    Frame& read_frame()
+    {
+        return m_frames[m_read];
+    }
+
+    // every frame, e.g. to set them up before the writer starts
+    Frame& frame(unsigned int index)
+    {
+        return m_frames[index];
+    }
+
+private:
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+
+    Frame                     m_frames[3];
+    unsigned int              m_write;
+    std::atomic<unsigned int> m_latest; // index of the newest frame, FRESH until it is read
+    unsigned int              m_read;
+};
+
+// runs a particle class at a fixed rate on a thread of its own. after the
+// steps that were due the thread copies the class into a frame and
+// publishes it; the render thread draws the newest frame, interpolated by
+// the time since it was published, and never touches the class itself.
+// input such as the emitter position is posted as commands that run on the
+// simulation thread before its next steps.
+//
+// System needs update(sf::Time) and build_frame(ParticleFrame&) const.
+template <typename System>
+class SimulationThread
+{
+public:
+    typedef std::function<void(System&)> Command;
+
+    SimulationThread(System& system, const FixedTimestep& timestep)
+    : m_system(system),
+      m_timestep(timestep),
+      m_step(timestep.step()),
+      m_stop(false)
+    {
+        m_thread = std::thread(&SimulationThread::run, this);
+    }
+
+    ~SimulationThread()
+    {
+        m_stop = true;
+        m_thread.join();
+    }
+
+    SimulationThread(const SimulationThread&)            = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void post(Command command)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_commands.push_back(std::move(command));
+    }
+
+    // the newest frame with its interpolation set for now. it stays valid
+    // and unchanged until the next call.
+    const ParticleFrame& frame()
+    {
+        m_frames.acquire();
+
+        ParticleFrame& frame = m_frames.read_frame();
+        frame.set_alpha(frame.published.getElapsedTime().asSeconds() / m_step.asSeconds());
+
+        return frame;
+    }
+
+    // draw every frame through one ring of streaming GPU buffers. from the
+    // render thread before the first frame() call; returns false and keeps
+    // the vertex arrays if buffers are not available.
+    bool use_vertex_buffers(unsigned int ring_size = 3)
+    {
+        if (!m_ring.create(ring_size))
+        {
+            return false;
+        }
+
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            m_frames.frame(i).use_vertex_ring(&m_ring);
+        }
+
+        return true;
+    }
+
+    const UploadStats& upload_stats() const
+    {
+        return m_ring.stats();
+    }
+
+private:
+    void run()
+    {
+        std::vector<Command> commands;
+        sf::Clock            clock;
+
+        while (!m_stop)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                commands.swap(m_commands);
+            }
+
+            for (Command& command : commands)
+            {
+                command(m_system);
+            }
+
+            commands.clear();
+
+            const unsigned int steps = m_timestep.advance(clock.restart());
+
+            if (steps > 0)
+            {
+                sf::Clock timer;
+
+                for (unsigned int step = 0; step < steps; ++step)
+                {
+                    m_system.update(m_step);
+                }
+
+                const sf::Time update_time = timer.restart();
+
+                ParticleFrame& frame = m_frames.write_frame();
+                m_system.build_frame(frame);
+
+                frame.step        = m_step.asSeconds();
+                frame.update_time = update_time;
+                frame.build_time  = timer.getElapsedTime();
+                frame.published.restart();
+
+                m_frames.publish();
+            }
+
+            // sleep through the rest of the step, rounding down so the next
+            // step is not late by a whole scheduler tick
+            const sf::Time idle = m_timestep.until_next() - clock.getElapsedTime();
+
+            if (idle > sf::milliseconds(1))
+            {
+                sf::sleep(idle - sf::milliseconds(1));
+            }
+        }
+    }
+
+    System&       m_system;
+    FixedTimestep m_timestep;
+    sf::Time      m_step;
+
+    TripleBuffer<ParticleFrame> m_frames;
+    VertexRing                  m_ring; // render thread only
+
+    std::mutex           m_mutex;
+    std::vector<Command> m_commands;
+
+    std::atomic<bool> m_stop;
+    std::thread       m_thread;
+};
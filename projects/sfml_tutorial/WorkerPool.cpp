@@ -0,0 +1,123 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned int num_threads)
+: m_task(nullptr),
+  m_count(0),
+  m_chunk_size(0),
+  m_generation(0),
+  m_pending(0),
+  m_stop(false)
+{
+    // the caller takes chunk 0, so only num_threads - 1 workers are spawned
+    for (unsigned int i = 1; i < std::max(num_threads, 1u); ++i)
+    {
+        m_threads.emplace_back(&WorkerPool::worker_loop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_start.notify_all();
+
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+unsigned int WorkerPool::size() const
+{
+    return static_cast<unsigned int>(m_threads.size()) + 1;
+}
+
+std::size_t WorkerPool::cache_line_elements(std::size_t element_size)
+{
+    std::size_t a = CACHE_LINE_SIZE;
+    std::size_t b = element_size;
+
+    while (b != 0)
+    {
+        std::size_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    // lcm(CACHE_LINE_SIZE, element_size) / element_size
+    return CACHE_LINE_SIZE / a;
+}
+
+void WorkerPool::parallel_for(std::size_t count, std::size_t alignment, const Task& task)
+{
+    const std::size_t num_chunks = size();
+
+    alignment = std::max<std::size_t>(alignment, 1);
+
+    // round the chunk size up to the alignment so chunks never share a cache line
+    std::size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+    chunk_size = ((chunk_size + alignment - 1) / alignment) * alignment;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task       = &task;
+        m_count      = count;
+        m_chunk_size = chunk_size;
+        m_pending    = static_cast<unsigned int>(m_threads.size());
+        ++m_generation;
+    }
+
+    m_start.notify_all();
+
+    run_chunk(0);
+
+    // join: nothing may touch the particles until every worker is done
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_pending == 0; });
+    m_task = nullptr;
+}
+
+void WorkerPool::run_chunk(std::size_t chunk)
+{
+    const std::size_t begin = std::min(chunk * m_chunk_size, m_count);
+    const std::size_t end   = std::min(begin + m_chunk_size, m_count);
+
+    if (begin < end)
+    {
+        (*m_task)(chunk, begin, end);
+    }
+}
+
+void WorkerPool::worker_loop(std::size_t chunk)
+{
+    unsigned long generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [&] { return m_stop || m_generation != generation; });
+
+            if (m_stop)
+            {
+                return;
+            }
+
+            generation = m_generation;
+        }
+
+        run_chunk(chunk);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_pending;
+        }
+
+        m_done.notify_one();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of threads that stay alive for the lifetime of the pool and
+// split index ranges between them; the calling thread works on chunk 0
+class WorkerPool
+{
+public:
+    // chunk index, first element and one past the last element of the chunk
+    typedef std::function<void(std::size_t, std::size_t, std::size_t)> Task;
+
+    static const std::size_t CACHE_LINE_SIZE = 64;
+
+    explicit WorkerPool(unsigned int num_threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&)            = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // number of threads taking part in parallel_for, including the caller
+    unsigned int size() const;
+
+    // splits [0, count) into size() chunks whose boundaries fall on multiples
+    // of `alignment` elements, runs `task` on each and blocks until all are done.
+    // chunk i always has the same bounds for the same count and pool size.
+    void parallel_for(std::size_t count, std::size_t alignment, const Task& task);
+
+    // smallest number of elements of the given size that fills whole cache lines
+    static std::size_t cache_line_elements(std::size_t element_size);
+
+private:
+    void worker_loop(std::size_t chunk);
+    void run_chunk(std::size_t chunk);
+
+    std::vector<std::thread> m_threads;
+    std::mutex               m_mutex;
+    std::condition_variable  m_start;
+    std::condition_variable  m_done;
+
+    const Task*   m_task;
+    std::size_t   m_count;
+    std::size_t   m_chunk_size;
+    unsigned long m_generation;
+    unsigned int  m_pending;
+    bool          m_stop;
+};
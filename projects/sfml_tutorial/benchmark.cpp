@@ -0,0 +1,402 @@
+#include "FramePipeline.hpp"
+#include "MyEntity.hpp"
+#include "ParticleEmitter.hpp"
+#include "particle_system/ParticleSystem.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// headless benchmark: drives each particle system for a fixed number of
+// frames with a fixed dt and a scripted emitter path, optionally rendering
+// into an offscreen texture, and prints the results as JSON on stdout.
+// with --pipeline the updates run on a FramePipeline thread, overlapped with
+// drawing the frame before, and frame_ms shows what that saves.
+
+static const unsigned int WIDTH  = 1920;
+static const unsigned int HEIGHT = 1080;
+
+// MyEntity draws points, with --collisions they collide as discs of this radius
+static const float ENTITY_RADIUS = 1.f;
+
+struct BenchConfig
+{
+    unsigned int frames     = 600;
+    float        dt         = 1.f / 60.f;
+    unsigned int threads    = 1;
+    bool         draw       = false;
+    bool         collisions = false;
+    bool         pipeline   = false;
+    std::size_t  particles  = 0; // 0 keeps each system's default count
+};
+
+struct Percentiles
+{
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    double mean;
+};
+
+static double now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+// peak resident set size of the process in kilobytes. it is a high-water
+// mark over the whole run, so it is only reported once for all systems.
+static long peak_rss_kb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+    }
+
+    return -1;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static Percentiles percentiles(std::vector<double> samples)
+{
+    Percentiles result = {0.0, 0.0, 0.0, 0.0, 0.0};
+
+    if (samples.empty())
+    {
+        return result;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    // nearest-rank percentile
+    auto rank = [&](double p)
+    {
+        std::size_t index = static_cast<std::size_t>(std::ceil(p * samples.size()));
+        return samples[std::min(std::max<std::size_t>(index, 1), samples.size()) - 1];
+    };
+
+    double sum = 0.0;
+
+    for (double sample : samples)
+    {
+        sum += sample;
+    }
+
+    result.p50  = rank(0.50);
+    result.p90  = rank(0.90);
+    result.p99  = rank(0.99);
+    result.max  = samples.back();
+    result.mean = sum / samples.size();
+
+    return result;
+}
+
+static std::string to_json(const Percentiles& p)
+{
+    std::ostringstream out;
+    out << "{\"p50\": " << p.p50
+        << ", \"p90\": " << p.p90
+        << ", \"p99\": " << p.p99
+        << ", \"max\": " << p.max
+        << ", \"mean\": " << p.mean << "}";
+    return out.str();
+}
+
+// the emitter traces a Lissajous figure across the screen
+static sf::Vector2f emitter_path(unsigned int frame, float dt)
+{
+    const float t = frame * dt;
+    return sf::Vector2f(WIDTH  * (0.5f + 0.4f * std::cos(t)),
+                        HEIGHT * (0.5f + 0.4f * std::sin(2.f * t)));
+}
+
+// milliseconds per frame, a frame is an update plus an optional draw
+struct FrameSamples
+{
+    std::vector<double> update_ms;
+    std::vector<double> draw_ms;
+    std::vector<double> frame_ms;
+};
+
+template <typename Drawable>
+static double draw_ms(sf::RenderTexture& target, const Drawable& drawable)
+{
+    const double start = now_ms();
+    target.clear();
+    target.draw(drawable);
+    target.display();
+
+    // wait for the GPU so the sample covers the whole submission
+    glFinish();
+    return now_ms() - start;
+}
+
+// update and draw back to back on this thread
+template <typename System>
+static void run_serial(System& system, const BenchConfig& config, sf::RenderTexture* target, FrameSamples& samples)
+{
+    const sf::Time elapsed = sf::seconds(config.dt);
+
+    for (unsigned int frame = 0; frame < config.frames; ++frame)
+    {
+        const double frame_start = now_ms();
+
+        system.set_emitter(emitter_path(frame, config.dt));
+
+        const double start = now_ms();
+        system.update(elapsed);
+        samples.update_ms.push_back(now_ms() - start);
+
+        if (target != nullptr)
+        {
+            samples.draw_ms.push_back(draw_ms(*target, system));
+        }
+
+        samples.frame_ms.push_back(now_ms() - frame_start);
+    }
+}
+
+// the updates of frame N + 1 run on the pipeline thread while this thread
+// draws frame N. each call hands over exactly one step of dt, so the system
+// sees the same updates as with run_serial. the first call only returns the
+// initial state and the last one hands over no step, so frames + 1 calls
+// sample every update once and nothing else.
+template <typename System>
+static void run_pipelined(System& system, const BenchConfig& config, sf::RenderTexture* target, FrameSamples& samples)
+{
+    const sf::Time elapsed = sf::seconds(config.dt);
+
+    FramePipeline<System> pipeline(system, FixedTimestep(elapsed, 1));
+
+    for (unsigned int frame = 0; frame <= config.frames; ++frame)
+    {
+        const double start = now_ms();
+
+        const bool last = frame == config.frames;
+
+        if (!last)
+        {
+            const sf::Vector2f emitter = emitter_path(frame, config.dt);
+            pipeline.post([emitter](System& particles) { particles.set_emitter(emitter); });
+        }
+
+        const ParticleFrame& current = pipeline.frame(last ? sf::Time::Zero : elapsed);
+
+        if (frame == 0)
+        {
+            continue;
+        }
+
+        // update_time excludes copying the particles into the frame
+        samples.update_ms.push_back(current.update_time.asSeconds() * 1.0e3);
+
+        if (target != nullptr)
+        {
+            samples.draw_ms.push_back(draw_ms(*target, current));
+        }
+
+        samples.frame_ms.push_back(now_ms() - start);
+    }
+}
+
+template <typename System>
+static std::string run_system(const std::string& name,
+                              System& system,
+                              std::size_t num_particles,
+                              const BenchConfig& config,
+                              sf::RenderTexture* target)
+{
+    FrameSamples samples;
+
+    samples.update_ms.reserve(config.frames);
+    samples.draw_ms.reserve(config.frames);
+    samples.frame_ms.reserve(config.frames);
+
+    if (config.pipeline)
+    {
+        run_pipelined(system, config, target, samples);
+    }
+    else
+    {
+        run_serial(system, config, target, samples);
+    }
+
+    double total_update_s = 0.0;
+
+    for (double sample : samples.update_ms)
+    {
+        total_update_s += sample * 1.0e-3;
+    }
+
+    std::ostringstream out;
+    out << "    {\"name\": \"" << name << "\""
+        << ", \"particles\": " << num_particles
+        << ", \"update_ms\": " << to_json(percentiles(samples.update_ms))
+        << ", \"draw_ms\": " << (target != nullptr ? to_json(percentiles(samples.draw_ms)) : "null")
+        << ", \"frame_ms\": " << to_json(percentiles(samples.frame_ms))
+        << ", \"contacts\": " << system.contacts()
+        << ", \"particles_per_sec\": " << (total_update_s > 0.0 ? num_particles * config.frames / total_update_s : 0.0)
+        << "}";
+    return out.str();
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "usage: " << program << " [--frames N] [--dt SECONDS] [--threads N] [--particles N] [--draw] [--collisions] [--pipeline]" << std::endl;
+}
+
+static bool parse_args(int argc, char* argv[], BenchConfig& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool has_value = i + 1 < argc;
+
+        if (std::strcmp(argv[i], "--frames") == 0 && has_value)
+        {
+            config.frames = static_cast<unsigned int>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--dt") == 0 && has_value)
+        {
+            config.dt = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+        {
+            config.threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--particles") == 0 && has_value)
+        {
+            config.particles = static_cast<std::size_t>(std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--draw") == 0)
+        {
+            config.draw = true;
+        }
+        else if (std::strcmp(argv[i], "--collisions") == 0)
+        {
+            config.collisions = true;
+        }
+        else if (std::strcmp(argv[i], "--pipeline") == 0)
+        {
+            config.pipeline = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig config;
+
+    if (!parse_args(argc, argv, config))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (config.threads == 0)
+    {
+        config.threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // rendering is optional so the benchmark also runs without a display
+    std::unique_ptr<sf::RenderTexture> target;
+
+    if (config.draw)
+    {
+        target.reset(new sf::RenderTexture());
+
+        if (!target->create(WIDTH, HEIGHT))
+        {
+            std::cerr << "Failed to create offscreen render target, skipping draw" << std::endl;
+            target.reset();
+        }
+    }
+
+    WorkerPool pool(config.threads);
+    WorkerPool* workers = config.threads > 1 ? &pool : nullptr;
+
+    // same particle counts as the interactive programs unless overridden
+    const std::size_t system_count  = config.particles ? config.particles : 100000;
+    const std::size_t entity_count  = config.particles ? config.particles : 1000000;
+    const std::size_t emitter_count = config.particles ? config.particles : 1000;
+
+    std::vector<std::string> results;
+
+    {
+        ParticleSystem system(static_cast<unsigned int>(system_count));
+        system.set_worker_pool(workers);
+        system.enable_collisions(config.collisions);
+        results.push_back(run_system("ParticleSystem", system, system_count, config, target.get()));
+    }
+
+    {
+        MyEntity entity(static_cast<unsigned int>(entity_count));
+        entity.set_worker_pool(workers);
+        entity.set_collision_radius(config.collisions ? ENTITY_RADIUS : 0.f);
+        results.push_back(run_system("MyEntity", entity, entity_count, config, target.get()));
+    }
+
+    {
+        ParticleEmitter emitter(emitter_count, 3.f, 10.f, 12);
+        emitter.set_worker_pool(workers);
+        emitter.enable_collisions(config.collisions);
+        results.push_back(run_system("ParticleEmitter", emitter, emitter_count, config, target.get()));
+    }
+
+    std::cout << "{\n"
+              << "  \"frames\": " << config.frames << ",\n"
+              << "  \"dt\": " << config.dt << ",\n"
+              << "  \"threads\": " << config.threads << ",\n"
+              << "  \"kernel\": \"" << to_string(particle_kernel_isa()) << "\",\n"
+              << "  \"draw\": " << (target ? "true" : "false") << ",\n"
+              << "  \"collisions\": " << (config.collisions ? "true" : "false") << ",\n"
+              << "  \"pipeline\": " << (config.pipeline ? "true" : "false") << ",\n"
+              << "  \"systems\": [\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        std::cout << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    std::cout << "  ],\n"
+              << "  \"peak_rss_kb\": " << peak_rss_kb() << "\n"
+              << "}" << std::endl;
+
+    return 0;
+}
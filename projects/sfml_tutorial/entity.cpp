@@ -1,36 +1,49 @@
+#include "FramePipeline.hpp"
 #include "MyEntity.hpp"
+#include "SimulationThread.hpp"
 
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
+
+#ifdef USE_OPENCL
+#include "ParticleCompute.hpp"
+#endif
 
 static unsigned int NUM_PARTICLES = 1000000;
 
-int main()
-{
-    sf::RenderWindow window(sf::VideoMode(1920, 1080), "My Entity!");
+// particles per second, a negative rate respawns every particle in place
+static float EMISSION_RATE = -1.f;
 
-    // create the entity
-    MyEntity my_entity(NUM_PARTICLES);
+// particles spawned per mouse click when an emission rate is set
+static std::size_t BURST_SIZE = 100000;
 
-    sf::Font font;
+// the simulation advances in fixed steps of STEP and catches up at most
+// MAX_SUBSTEPS steps at a time after a stall. true runs the steps due each
+// rendered frame on a second thread, overlapped with drawing the frame
+// before; false runs them at the fixed rate on a thread of their own.
+static bool         PIPELINED    = true;
+static sf::Time     STEP         = sf::seconds(1.f / 60.f);
+static unsigned int MAX_SUBSTEPS = 4;
 
-    if (!font.loadFromFile("saxmono.ttf"))
-    {
-        std::cerr << "Failed to load font" << std::endl;
-        return 1;
-    }
+#ifdef USE_OPENCL
+static std::string KERNEL_FILE = "../opencl_sbox/kernel_file.cl";
+#endif
 
-    sf::Text text;
-
-    text.setFont(font);
-    text.setCharacterSize(24);
-    text.setFillColor(sf::Color::Red);
+// draws the frames of a SimulationThread or a FramePipeline until the window
+// is closed, the entity is only reached through posted commands
+template <typename Simulation>
+static void run(sf::RenderWindow& window, sf::Text& text, Simulation& simulation)
+{
+    // stream the frames through a ring of GPU buffers when available
+    const bool use_buffers = simulation.use_vertex_buffers();
+    std::cout << "Vertex buffers: " << (use_buffers ? "yes" : "no") << std::endl;
 
-    // create a clock to track the elapsed time
     sf::Clock clock;
 
     while (window.isOpen())
@@ -43,25 +56,94 @@ int main()
             {
                 window.close();
             }
+            else if (event.type == sf::Event::MouseButtonPressed)
+            {
+                simulation.post([](MyEntity& entity) { entity.emit(BURST_SIZE); });
+            }
         }
 
         // make the partile system follow the mouse
-        sf::Vector2i mouse = sf::Mouse::getPosition(window);
-        my_entity.set_emitter(window.mapPixelToCoords(mouse));
-
-        // update it
-        sf::Time elapsed = clock.restart();
+        const sf::Vector2f emitter = window.mapPixelToCoords(sf::Mouse::getPosition(window));
+        simulation.post([emitter](MyEntity& entity) { entity.set_emitter(emitter); });
 
-        sf::Clock timer;
-        my_entity.update(elapsed);
-        sf::Time duration = timer.restart();
+        // the newest frame the simulation finished
+        const ParticleFrame& frame = simulation.frame();
 
         window.clear();
-        window.draw(my_entity);
-        text.setString(std::to_string(duration.asSeconds()));
+        window.draw(frame);
+
+        std::string overlay = std::to_string(frame.update_time.asSeconds());
+        overlay += "\nframe " + std::to_string(clock.restart().asSeconds());
+        overlay += "\nlive " + std::to_string(frame.particles);
+
+        if (use_buffers)
+        {
+            const UploadStats& stats = simulation.upload_stats();
+            overlay += "\nupload " + std::to_string(stats.bandwidth() / 1.0e6) + " MB/s";
+            overlay += "\nstall " + std::to_string(stats.stall_time.asMilliseconds()) + " ms";
+        }
+
+        text.setString(overlay);
         window.draw(text);
         window.display();
     }
+}
+
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(1920, 1080), "My Entity!");
+
+    // create the entity
+    MyEntity my_entity(NUM_PARTICLES);
+
+    // update the particles on all cores
+    WorkerPool pool(std::thread::hardware_concurrency());
+    my_entity.set_worker_pool(&pool);
+    my_entity.set_emission_rate(EMISSION_RATE);
+
+    std::cout << "Particle kernel: " << to_string(particle_kernel_isa()) << std::endl;
+
+#ifdef USE_OPENCL
+    // integrate on an OpenCL device, the pool then only mirrors the vertices
+    std::unique_ptr<ParticleCompute> compute;
+
+    try
+    {
+        compute.reset(new ParticleCompute(KERNEL_FILE));
+        my_entity.set_integrator(compute.get());
+        std::cout << "OpenCL device: " << compute->device_name() << std::endl;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "OpenCL not available, using the CPU kernel: " << e.what() << std::endl;
+    }
+#endif
+
+    sf::Font font;
+
+    if (!font.loadFromFile("saxmono.ttf"))
+    {
+        std::cerr << "Failed to load font" << std::endl;
+        return 1;
+    }
+
+    sf::Text text;
+
+    text.setFont(font);
+    text.setCharacterSize(24);
+    text.setFillColor(sf::Color::Red);
+
+    // from here on the entity belongs to the simulation thread
+    if (PIPELINED)
+    {
+        FramePipeline<MyEntity> pipeline(my_entity, FixedTimestep(STEP, MAX_SUBSTEPS));
+        run(window, text, pipeline);
+    }
+    else
+    {
+        SimulationThread<MyEntity> simulation(my_entity, FixedTimestep(STEP, MAX_SUBSTEPS));
+        run(window, text, simulation);
+    }
 
     return 0;
 }
\ No newline at end of file
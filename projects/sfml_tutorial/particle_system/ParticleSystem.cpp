@@ -1,8 +1,63 @@
 #include "ParticleSystem.hpp"
 
-#include <cmath>
 #include <iostream>
 
+static const sf::Color COLORS[] = {sf::Color::Red, sf::Color::Green, sf::Color::Blue};
+
+// respawned particles get a speed and a lifetime in these ranges, the alpha
+// fades over 3 seconds
+static SpawnParams spawn_params()
+{
+    SpawnParams spawn;
+    spawn.emitter      = sf::Vector2f(0.f, 0.f);
+    spawn.speed_min    = 50.f;
+    spawn.speed_max    = 100.f;
+    spawn.lifetime_min = 1.f;
+    spawn.lifetime_max = 3.f;
+    spawn.inv_lifetime = 1.f / 3.f;
+    return spawn;
+}
+
+// discards the fragments of a quad that fall outside the unit disc
+static const char* MASK_FRAGMENT_SHADER =
+    "void main()\n"
+    "{\n"
+    "    vec2 uv = gl_TexCoord[0].xy;\n"
+    "    if (dot(uv, uv) > 1.0)\n"
+    "        discard;\n"
+    "    gl_FragColor = gl_Color;\n"
+    "}\n";
+
+// triangle list around the centre of the shape, built from its own outline.
+// positions are the top-left corner of the bounding box, like sf::CircleShape
+static std::vector<sf::Vector2f> mesh_offsets(const sf::CircleShape& shape)
+{
+    const float        radius     = shape.getRadius();
+    const std::size_t  num_points = shape.getPointCount();
+    const sf::Vector2f center(radius, radius);
+
+    std::vector<sf::Vector2f> offsets;
+
+    for (std::size_t k = 0; k < num_points; ++k)
+    {
+        offsets.push_back(center);
+        offsets.push_back(shape.getPoint(k));
+        offsets.push_back(shape.getPoint((k + 1) % num_points));
+    }
+
+    return offsets;
+}
+
+ParticleSystem::ParticleSystem(unsigned int count, RenderMode mode)
+: ParticleSimulation(count,
+                     spawn_params(),
+                     std::vector<sf::Color>(COLORS, COLORS + 3),
+                     WorkerPool::cache_line_elements(sizeof(float))),
+  m_shape(5.f, 15),
+  m_mode(RenderMode::Shapes)
+{
+    set_render_mode(mode);
+}
 
 void ParticleSystem::draw(sf::RenderTarget& target,
                           sf::RenderStates states) const
@@ -10,51 +65,137 @@ void ParticleSystem::draw(sf::RenderTarget& target,
     states.transform *= getTransform();
     states.texture = NULL;
 
-    for (std::size_t i = 0; i < m_bodies.size(); ++i)
+    // only the live particles at the front of the store are drawn
+    const std::size_t live = m_store.live;
+
+    if (live == 0)
     {
-        target.draw(m_bodies[i], states);
+        return;
     }
-}
 
-void ParticleSystem::reset_particle(std::size_t index)
-{
-    float angle = (std::rand() % 360) * 3.14f / 180.f;
-    float speed = (std::rand() % 50) + 50.f;
-    m_particles[index].velocity = sf::Vector2f(std::cos(angle) * speed, std::sin(angle) * speed);
-    m_particles[index].lifetime = sf::milliseconds((std::rand() % 2000) + 1000);
+    if (m_mode != RenderMode::Shapes)
+    {
+        if (m_mode == RenderMode::Quads)
+        {
+            states.shader = &m_mask_shader;
+        }
 
-    m_bodies[index].setPosition(m_emitter);
+        // all particles in a single draw call
+        target.draw(&m_vertices[0], live * m_offsets.size(), m_vertices.getPrimitiveType(), states);
+        return;
+    }
 
-    std::vector<sf::Color> colors = {sf::Color::Red, sf::Color::Green, sf::Color::Blue};
-    m_bodies[index].setFillColor(colors[index % 3]);
+    for (std::size_t i = 0; i < live; ++i)
+    {
+        m_shape.setPosition(m_store.position[i]);
+        m_shape.setFillColor(m_store.color[i]);
+        target.draw(m_shape, states);
+    }
 }
 
-void ParticleSystem::set_emitter(sf::Vector2f position)
+void ParticleSystem::set_render_mode(RenderMode mode)
 {
-    m_emitter = position;
+    if (mode == RenderMode::Quads &&
+        (!sf::Shader::isAvailable() ||
+         !m_mask_shader.loadFromMemory(MASK_FRAGMENT_SHADER, sf::Shader::Fragment)))
+    {
+        std::cerr << "Shaders not available, falling back to mesh rendering" << std::endl;
+        mode = RenderMode::Mesh;
+    }
+
+    m_mode = mode;
+    m_offsets.clear();
+    m_tex_coords.clear();
+
+    // positions are the top-left corner of the bounding box, like sf::CircleShape
+    const float radius = m_shape.getRadius();
+
+    if (m_mode == RenderMode::Mesh)
+    {
+        m_offsets  = mesh_offsets(m_shape);
+        m_vertices = sf::VertexArray(sf::Triangles, m_offsets.size() * m_store.size());
+    }
+    else if (m_mode == RenderMode::Quads)
+    {
+        // texture coordinates span [-1, 1] so the shader can test against the unit disc
+        m_offsets    = {{0.f, 0.f}, {2.f * radius, 0.f}, {2.f * radius, 2.f * radius}, {0.f, 2.f * radius}};
+        m_tex_coords = {{-1.f, -1.f}, {1.f, -1.f}, {1.f, 1.f}, {-1.f, 1.f}};
+
+        m_vertices = sf::VertexArray(sf::Quads, m_offsets.size() * m_store.size());
+
+        // texture coordinates never change, so they are written only once
+        for (std::size_t i = 0; i < m_vertices.getVertexCount(); ++i)
+        {
+            m_vertices[i].texCoords = m_tex_coords[i % m_tex_coords.size()];
+        }
+    }
+    else
+    {
+        m_vertices = sf::VertexArray();
+    }
 }
 
-void ParticleSystem::update(sf::Time elapsed)
+void ParticleSystem::write_vertices(std::size_t begin, std::size_t end)
 {
-    for (std::size_t i = 0; i < m_particles.size(); ++i)
+    // the Shapes mode draws straight from the store
+    if (m_mode == RenderMode::Shapes)
     {
-        // update particle lifetime
-        Particle& p = m_particles[i];
-        p.lifetime -= elapsed;
+        return;
+    }
 
-        // if the particle is dead then respawn it
-        if (p.lifetime <= sf::Time::Zero)
+    const std::size_t stride = m_offsets.size();
+
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        const sf::Vector2f position = m_store.position[i];
+        const sf::Color    color    = m_store.color[i];
+        sf::Vertex*        vertex   = &m_vertices[i * stride];
+
+        for (std::size_t j = 0; j < stride; ++j)
         {
-            reset_particle(i);
+            vertex[j].position = position + m_offsets[j];
+            vertex[j].color    = color;
         }
+    }
+}
 
-        // update the position of the corresponding vertex
-        m_bodies[i].setPosition(m_bodies[i].getPosition() + (p.velocity * elapsed.asSeconds()));
+void ParticleSystem::enable_collisions(bool enabled)
+{
+    set_collision_radius(enabled ? m_shape.getRadius() : 0.f);
+}
 
-        // update the alpha (transparency) of the particle according to its lifetime
-        float ratio = p.lifetime.asSeconds() / m_lifetime.asSeconds();
-        sf::Color c = m_bodies[i].getFillColor();
-        c.a = static_cast<sf::Uint8>(ratio * 255);
-        m_bodies[i].setFillColor(c);
-    }
-}
\ No newline at end of file
+void ParticleSystem::build_frame(ParticleFrame& frame) const
+{
+    const std::size_t live   = m_store.live;
+    const bool        shapes = m_mode == RenderMode::Shapes;
+
+    // the Shapes mode keeps no vertices, its frames get one point per
+    // particle and stamp the shape on it with a draw call each
+    const std::size_t stride = shapes ? 1 : m_offsets.size();
+
+    frame.reset(shapes ? sf::Points : m_vertices.getPrimitiveType(), live, stride);
+    frame.set_stamp(shapes ? &m_shape : nullptr);
+    frame.shader    = m_mode == RenderMode::Quads ? &m_mask_shader : nullptr;
+    frame.transform = getTransform();
+
+    auto copy_range = [&](std::size_t, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            frame.velocity[i] = m_store.velocity[i];
+
+            if (shapes)
+            {
+                frame.vertices[i] = sf::Vertex(m_store.position[i], m_store.color[i]);
+                continue;
+            }
+
+            for (std::size_t j = i * stride; j < (i + 1) * stride; ++j)
+            {
+                frame.vertices[j] = m_vertices[j];
+            }
+        }
+    };
+
+    parallel_for(live, copy_range);
+}
@@ -1,35 +1,45 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 
-class ParticleSystem : public sf::Drawable, public sf::Transformable
+#include "ParticleFrame.hpp"
+#include "ParticleSimulation.hpp"
+
+class ParticleSystem : public sf::Drawable, public sf::Transformable, public ParticleSimulation
 {
+public:
+    enum class RenderMode
+    {
+        Shapes, // one CircleShape draw call per particle
+        Mesh,   // unit-circle triangle mesh per particle, single draw call
+        Quads   // one quad per particle masked to a disc in the fragment shader
+    };
+
 private:
     virtual void draw(sf::RenderTarget& target,
                       sf::RenderStates states) const;
 
 private:
-    struct Particle
-    {
-        sf::Vector2f velocity;
-        sf::Time     lifetime;
-    };
+    void set_render_mode(RenderMode mode);
+    virtual void write_vertices(std::size_t begin, std::size_t end);
 
-    void reset_particle(std::size_t index);
+    // the store is the source of truth, the shape is only a stamp for drawing
+    mutable sf::CircleShape m_shape;
 
-    std::vector<Particle>        m_particles;
-    std::vector<sf::CircleShape> m_bodies;
-    sf::Time                     m_lifetime;
-    sf::Vector2f                 m_emitter;
+    // batched rendering: every particle is stamped into one vertex stream
+    RenderMode                m_mode;
+    std::vector<sf::Vector2f> m_offsets;
+    std::vector<sf::Vector2f> m_tex_coords;
+    sf::VertexArray           m_vertices;
+    sf::Shader                m_mask_shader;
 
 public:
-    ParticleSystem(unsigned int count)
-    : m_particles(count),
-      m_bodies(std::vector<sf::CircleShape>(count, sf::CircleShape(5.f, 15))),
-      m_lifetime(sf::seconds(3.f)),
-      m_emitter(0.f, 0.f)
-    {}
+    ParticleSystem(unsigned int count, RenderMode mode = RenderMode::Mesh);
 
-    void set_emitter(sf::Vector2f position);
+    // particles bounce off each other as discs of the drawn radius, off by default
+    void enable_collisions(bool enabled);
 
-    void update(sf::Time elapsed);
-};
\ No newline at end of file
+    // copies what draw() shows into a frame that another thread can draw
+    // while the next update runs. frames of the Shapes mode still draw one
+    // CircleShape per particle.
+    void build_frame(ParticleFrame& frame) const;
+};
@@ -1,4 +1,6 @@
+#include "FramePipeline.hpp"
 #include "ParticleSystem.hpp"
+#include "SimulationThread.hpp"
 
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
@@ -6,31 +8,27 @@
 
 #include <iostream>
 #include <string>
+#include <thread>
 
 static unsigned int NUM_PARTICLES = 100000;
 
-int main()
+// Shapes issues one draw call per particle, also when drawn from a frame,
+// Mesh and Quads batch them all into one
+static ParticleSystem::RenderMode RENDER_MODE = ParticleSystem::RenderMode::Mesh;
+
+// the simulation advances in fixed steps of STEP and catches up at most
+// MAX_SUBSTEPS steps at a time after a stall. true runs the steps due each
+// rendered frame on a second thread, overlapped with drawing the frame
+// before; false runs them at the fixed rate on a thread of their own.
+static bool         PIPELINED    = true;
+static sf::Time     STEP         = sf::seconds(1.f / 60.f);
+static unsigned int MAX_SUBSTEPS = 4;
+
+// draws the frames of a SimulationThread or a FramePipeline until the window
+// is closed, the bodies are only reached through posted commands
+template <typename Simulation>
+static void run(sf::RenderWindow& window, sf::Text& text, Simulation& simulation)
 {
-    sf::RenderWindow window(sf::VideoMode(1920, 1080), "Particle System!");
-
-    // create the entity
-    ParticleSystem bodies(NUM_PARTICLES);
-
-    sf::Font font;
-
-    if (!font.loadFromFile("/usr/share/fonts/truetype/ubuntu/UbuntuMono-R.ttf"))
-    {
-        std::cerr << "Failed to load font" << std::endl;
-        return 1;
-    }
-
-    sf::Text text;
-
-    text.setFont(font);
-    text.setCharacterSize(24);
-    text.setFillColor(sf::Color::Red);
-
-    // create a clock to track the elapsed time
     sf::Clock clock;
 
     while (window.isOpen())
@@ -54,21 +52,56 @@ int main()
         }
 
         // make the partile system follow the mouse
-        bodies.set_emitter(window.mapPixelToCoords(mouse));
-
-        // update it
-        sf::Time elapsed = clock.restart();
+        const sf::Vector2f emitter = window.mapPixelToCoords(mouse);
+        simulation.post([emitter](ParticleSystem& system) { system.set_emitter(emitter); });
 
-        sf::Clock timer;
-        bodies.update(elapsed);
-        sf::Time duration = timer.restart();
+        // the newest frame the simulation finished
+        const ParticleFrame& frame = simulation.frame();
 
         window.clear();
-        window.draw(bodies);
-        text.setString(std::to_string(duration.asSeconds()));
+        window.draw(frame);
+        text.setString(std::to_string(frame.update_time.asSeconds()) + "\nframe " + std::to_string(clock.restart().asSeconds()));
         window.draw(text);
         window.display();
     }
+}
+
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(1920, 1080), "Particle System!");
+
+    // create the entity
+    ParticleSystem bodies(NUM_PARTICLES, RENDER_MODE);
+
+    // update the particles on all cores
+    WorkerPool pool(std::thread::hardware_concurrency());
+    bodies.set_worker_pool(&pool);
+
+    sf::Font font;
+
+    if (!font.loadFromFile("/usr/share/fonts/truetype/ubuntu/UbuntuMono-R.ttf"))
+    {
+        std::cerr << "Failed to load font" << std::endl;
+        return 1;
+    }
+
+    sf::Text text;
+
+    text.setFont(font);
+    text.setCharacterSize(24);
+    text.setFillColor(sf::Color::Red);
+
+    // from here on the bodies belong to the simulation thread
+    if (PIPELINED)
+    {
+        FramePipeline<ParticleSystem> pipeline(bodies, FixedTimestep(STEP, MAX_SUBSTEPS));
+        run(window, text, pipeline);
+    }
+    else
+    {
+        SimulationThread<ParticleSystem> simulation(bodies, FixedTimestep(STEP, MAX_SUBSTEPS));
+        run(window, text, simulation);
+    }
 
     return 0;
 }
\ No newline at end of file
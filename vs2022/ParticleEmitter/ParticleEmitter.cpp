@@ -1,6 +1,87 @@
 #include "ParticleEmitter.hpp"
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <string>
+
+static const float TWO_PI = 6.28318531f;
+
+// respawned particles get a speed in [50, 100) and a lifetime in [2, 4)
+// seconds, and fade out over `lifetime` seconds
+static SpawnParams spawn_params(float lifetime)
+{
+	SpawnParams spawn;
+	spawn.emitter      = sf::Vector2f(0.f, 0.f);
+	spawn.speed_min    = 50.f;
+	spawn.speed_max    = 100.f;
+	spawn.lifetime_min = 2.f;
+	spawn.lifetime_max = 4.f;
+	spawn.inv_lifetime = 1.f / lifetime;
+	return spawn;
+}
+
+// GPU expansion: one point per particle goes in, the geometry shader turns it
+// into the same triangle list that build_mesh() produces on the CPU
+static const char* DISC_VERTEX_SHADER =
+	"#version 150 compatibility\n"
+	"out vec4 v_color;\n"
+	"void main()\n"
+	"{\n"
+	"    gl_Position = gl_ModelViewMatrix * gl_Vertex;\n"
+	"    v_color = gl_Color;\n"
+	"}\n";
+
+static const char* DISC_GEOMETRY_SHADER =
+	"#version 150 compatibility\n"
+	"layout (points) in;\n"
+	"layout (triangle_strip, max_vertices = MAX_VERTICES) out;\n"
+	"uniform float radius;\n"
+	"uniform int num_triangles;\n"
+	"in vec4 v_color[];\n"
+	"out vec4 g_color;\n"
+	"void main()\n"
+	"{\n"
+	"    vec4 center = gl_in[0].gl_Position;\n"
+	"    float sector_angle = 6.28318531 / float(num_triangles);\n"
+	"    g_color = v_color[0];\n"
+	"    for (int k = 0; k < num_triangles; ++k)\n"
+	"    {\n"
+	"        float theta_0 = float(k) * sector_angle;\n"
+	"        float theta_1 = float(k + 1) * sector_angle;\n"
+	"        gl_Position = gl_ProjectionMatrix * center;\n"
+	"        EmitVertex();\n"
+	"        gl_Position = gl_ProjectionMatrix * (center + vec4(cos(theta_0) * radius, sin(theta_0) * radius, 0.0, 0.0));\n"
+	"        EmitVertex();\n"
+	"        gl_Position = gl_ProjectionMatrix * (center + vec4(cos(theta_1) * radius, sin(theta_1) * radius, 0.0, 0.0));\n"
+	"        EmitVertex();\n"
+	"        EndPrimitive();\n"
+	"    }\n"
+	"}\n";
+
+static const char* DISC_FRAGMENT_SHADER =
+	"#version 150 compatibility\n"
+	"in vec4 g_color;\n"
+	"void main()\n"
+	"{\n"
+	"    gl_FragColor = g_color;\n"
+	"}\n";
+
+ParticleEmitter::ParticleEmitter(std::size_t num_particles,
+	float lifetime,
+	float radius,
+	std::size_t num_triangles,
+	RenderMode mode)
+	: ParticleSimulation(num_particles,
+		spawn_params(lifetime),
+		std::vector<sf::Color>(), // a random colour per particle
+		WorkerPool::cache_line_elements(sizeof(float))),
+	m_radius(radius),
+	m_num_triangles(num_triangles),
+	m_mode(RenderMode::CpuMesh)
+{
+	build_mesh();
+	set_render_mode(mode);
+}
 
 void ParticleEmitter::draw(sf::RenderTarget& target, sf::RenderStates states) const
 {
@@ -8,104 +89,125 @@ void ParticleEmitter::draw(sf::RenderTarget& target, sf::RenderStates states) co
 
 	states.texture = NULL;
 
-	target.draw(m_vertices, states);
-}
+	if (m_mode == RenderMode::GpuExpand)
+	{
+		states.shader = &m_disc_shader;
+	}
 
-void ParticleEmitter::reset_particle(std::size_t index)
-{
-	// give random velocity and lifetime to the particle
-	float angle = (std::rand() % 360) * 3.14f / 180.f;
-	float speed = (std::rand() % 50) + 50.f;
-	m_particles[index].velocity = sf::Vector2f(std::cos(angle) * speed, std::sin(angle) * speed);
-	m_particles[index].lifetime = sf::milliseconds((std::rand() % 2000) + 2000);
+	// only the live particles at the front of the store are drawn
+	const std::size_t live = m_store.live;
 
-	// reset the position of the corresponding vertex
-	m_particles[index].center = m_emitter;
+	if (live == 0)
+	{
+		return;
+	}
 
-	// assign a random color to the particle
-	std::vector<sf::Color> colors = { sf::Color::Red, sf::Color::Green, sf::Color::Blue };
-	m_particles[index].color = sf::Color(std::rand() % 255, std::rand() % 255, std::rand() % 255);
+	const std::size_t vertices_per_particle = m_mode == RenderMode::GpuExpand ? 1 : m_mesh.size();
 
-	// calculate vertices for this particle
-	draw_particle(index);
+	target.draw(&m_vertices[0], live * vertices_per_particle, m_vertices.getPrimitiveType(), states);
 }
 
-void ParticleEmitter::draw_particle(std::size_t index)
+void ParticleEmitter::set_render_mode(RenderMode mode)
 {
-	const float pi                   = 22.f / 7.f;
-	const float two_pi               = 2.f * pi;
-	const std::size_t total_vertices = m_num_triangles * 3;
-	const float sector_angle         = two_pi / m_num_triangles;
-
-	Particle p = m_particles[index];
-
-	std::size_t start_idx = index * total_vertices;
-	std::size_t end_idx = start_idx + total_vertices;
-	std::size_t idx = start_idx;
-
-	for (float theta = 0.f; idx < end_idx; theta += sector_angle)
+	if (mode == RenderMode::GpuExpand)
 	{
-		sf::Vector2f vertex(std::cos(theta) * m_radius, std::sin(theta) * m_radius);
+		// max_vertices has to be a compile-time constant in the shader
+		std::string geometry_shader(DISC_GEOMETRY_SHADER);
+		std::string max_vertices = std::to_string(m_num_triangles * 3);
+		geometry_shader.replace(geometry_shader.find("MAX_VERTICES"), std::string("MAX_VERTICES").size(), max_vertices);
 
-		if (idx == start_idx)
-		{
-			m_vertices[idx] = sf::Vertex(p.center, p.color);
-			++idx;
-		}
-		else if (idx < start_idx + 3)
+		if (!sf::Shader::isGeometryAvailable() ||
+			!m_disc_shader.loadFromMemory(DISC_VERTEX_SHADER, geometry_shader, DISC_FRAGMENT_SHADER))
 		{
-			m_vertices[idx] = sf::Vertex(p.center + vertex, p.color);
-			++idx;
+			std::cerr << "Geometry shaders not available, falling back to CPU mesh expansion" << std::endl;
+			mode = RenderMode::CpuMesh;
 		}
 		else
 		{
-			m_vertices[idx] = sf::Vertex(m_vertices[idx - 1].position, p.color);
-			m_vertices[idx] = sf::Vertex(p.center, p.color);
-			m_vertices[idx] = sf::Vertex(p.center + vertex, p.color);
-
-			idx += 3;
+			m_disc_shader.setUniform("radius", m_radius);
+			m_disc_shader.setUniform("num_triangles", static_cast<int>(m_num_triangles));
 		}
 	}
+
+	m_mode = mode;
+
+	if (m_mode == RenderMode::GpuExpand)
+	{
+		m_vertices = sf::VertexArray(sf::Points, m_store.size());
+	}
+	else
+	{
+		m_vertices = sf::VertexArray(sf::Triangles, m_mesh.size() * m_store.size());
+	}
 }
 
-void ParticleEmitter::move_particle(std::size_t index, sf::Time elapsed_time)
+void ParticleEmitter::build_mesh()
 {
-	const std::size_t total_vertices = m_num_triangles * 3;
-	Particle p = m_particles[index];
+	// triangle list around the origin, computed once per (radius, num_triangles)
+	const float sector_angle = TWO_PI / m_num_triangles;
 
-	std::size_t start_idx = index * total_vertices;
-	std::size_t end_idx = start_idx + total_vertices;
+	m_mesh.resize(m_num_triangles * 3);
 
-	float ratio = p.lifetime.asSeconds() / m_lifetime.asSeconds();
+	for (std::size_t k = 0; k < m_num_triangles; ++k)
+	{
+		const float theta_0 = k * sector_angle;
+		const float theta_1 = ((k + 1) % m_num_triangles) * sector_angle;
 
-	for (size_t i = start_idx; i < end_idx; ++i)
+		m_mesh[3 * k]     = sf::Vector2f(0.f, 0.f);
+		m_mesh[3 * k + 1] = sf::Vector2f(std::cos(theta_0) * m_radius, std::sin(theta_0) * m_radius);
+		m_mesh[3 * k + 2] = sf::Vector2f(std::cos(theta_1) * m_radius, std::sin(theta_1) * m_radius);
+	}
+}
+
+void ParticleEmitter::write_vertices(std::size_t begin, std::size_t end)
+{
+	for (std::size_t i = begin; i < end; ++i)
 	{
-		// update position
-		m_vertices[i].position += p.velocity * elapsed_time.asSeconds();
+		const sf::Vector2f center = m_store.position[i];
+		const sf::Color    color  = m_store.color[i];
 
-		// update transparency
-		m_vertices[i].color.a = static_cast<sf::Uint8>(ratio * 255);
+		if (m_mode == RenderMode::GpuExpand)
+		{
+			// a single write per particle, the disc is expanded on the GPU
+			m_vertices[i] = sf::Vertex(center, color);
+			continue;
+		}
+
+		sf::Vertex* vertex = &m_vertices[i * m_mesh.size()];
+
+		// stamp the unit mesh at the particle centre
+		for (std::size_t j = 0; j < m_mesh.size(); ++j)
+		{
+			vertex[j] = sf::Vertex(center + m_mesh[j], color);
+		}
 	}
 }
 
-void ParticleEmitter::set_emitter(sf::Vector2f position)
+void ParticleEmitter::enable_collisions(bool enabled)
 {
-	m_emitter = position;
+	set_collision_radius(enabled ? m_radius : 0.f);
 }
 
-void ParticleEmitter::update(sf::Time elapsed)
+void ParticleEmitter::build_frame(ParticleFrame& frame) const
 {
-	for (std::size_t i = 0; i < m_particles.size(); ++i)
-	{
-		Particle& p = m_particles[i];
+	const std::size_t stride = m_mode == RenderMode::GpuExpand ? 1 : m_mesh.size();
 
-		p.lifetime -= elapsed;
+	frame.reset(m_vertices.getPrimitiveType(), m_store.live, stride);
+	frame.shader    = m_mode == RenderMode::GpuExpand ? &m_disc_shader : nullptr;
+	frame.transform = getTransform();
 
-		if (p.lifetime <= sf::Time::Zero)
+	auto copy_range = [&](std::size_t, std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; ++i)
 		{
-			reset_particle(i);
+			frame.velocity[i] = m_store.velocity[i];
+
+			for (std::size_t j = i * stride; j < (i + 1) * stride; ++j)
+			{
+				frame.vertices[j] = m_vertices[j];
+			}
 		}
+	};
 
-		move_particle(i, elapsed);
-	}
+	parallel_for(m_store.live, copy_range);
 }
@@ -2,44 +2,48 @@
 
 #include <vector>
 
-class ParticleEmitter : public sf::Drawable, public sf::Transformable
-{
-private:
-	virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+#include "ParticleFrame.hpp"
+#include "ParticleSimulation.hpp"
 
-	struct Particle
+class ParticleEmitter : public sf::Drawable, public sf::Transformable, public ParticleSimulation
+{
+public:
+	enum class RenderMode
 	{
-		sf::Vector2f center;
-		sf::Vector2f velocity;
-		sf::Time     lifetime;
-		sf::Color    color;
+		CpuMesh,  // every particle's disc is expanded into triangles on the CPU
+		GpuExpand // one point per particle, the disc is expanded in a geometry shader
 	};
 
-	void reset_particle(std::size_t index);
-	void draw_particle(std::size_t index);
-	void move_particle(std::size_t index, sf::Time elapsed_time);
+private:
+	virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const;
+
+	void build_mesh();
+	void set_render_mode(RenderMode mode);
+	virtual void write_vertices(std::size_t begin, std::size_t end);
 
-	std::vector<Particle> m_particles;
-	sf::VertexArray       m_vertices;
-	sf::Time              m_lifetime;
-	sf::Vector2f          m_emitter;
+	sf::VertexArray m_vertices;
 
 	float m_radius;
 	std::size_t m_num_triangles;
 
+	// vertex offsets of one particle's disc relative to its centre
+	std::vector<sf::Vector2f> m_mesh;
+
+	RenderMode m_mode;
+	sf::Shader m_disc_shader;
+
 public:
+	// particles get a random colour and fade out over `lifetime` seconds
 	ParticleEmitter(std::size_t num_particles,
 		float lifetime,
 		float radius,
-		std::size_t num_triangles)
-		: m_particles(num_particles),
-		m_vertices(sf::Triangles, num_triangles * 3 * num_particles),
-		m_lifetime(sf::seconds(lifetime)),
-		m_radius(radius),
-		m_num_triangles(num_triangles)
-	{}
+		std::size_t num_triangles,
+		RenderMode mode = RenderMode::CpuMesh);
 
-	void set_emitter(sf::Vector2f position);
+	// particles bounce off each other as discs of m_radius, off by default
+	void enable_collisions(bool enabled);
 
-	void update(sf::Time elapsed);
+	// copies what draw() shows into a frame that another thread can draw
+	// while the next update runs
+	void build_frame(ParticleFrame& frame) const;
 };
\ No newline at end of file
@@ -1,4 +1,6 @@
+#include "FramePipeline.hpp"
 #include "ParticleEmitter.hpp"
+#include "SimulationThread.hpp"
 
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
@@ -7,6 +9,42 @@
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
+
+// draws the frames of a SimulationThread or a FramePipeline until the window
+// is closed, the emitter is only reached through posted commands
+template <typename Simulation>
+static void run(sf::RenderWindow& window, sf::Text& text, Simulation& simulation)
+{
+    sf::Clock clock;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+            {
+                window.close();
+            }
+        }
+
+        // make the partile system follow the mouse
+        const sf::Vector2f emitter = window.mapPixelToCoords(sf::Mouse::getPosition(window));
+        simulation.post([emitter](ParticleEmitter& system) { system.set_emitter(emitter); });
+
+        // the newest frame the simulation finished
+        const ParticleFrame& frame = simulation.frame();
+
+        window.clear();
+        window.draw(frame);
+
+        text.setString(std::to_string(frame.update_time.asSeconds()) + "\nframe " + std::to_string(clock.restart().asSeconds()));
+        window.draw(text);
+        window.display();
+    }
+}
 
 int main()
 {
@@ -17,11 +55,26 @@ int main()
     const std::size_t NUM_TRIANGLES = 12;
     const std::size_t NUM_PARTICLES = 1000;
 
+    // the simulation advances in fixed steps of STEP and catches up at most
+    // MAX_SUBSTEPS steps at a time after a stall. true runs the steps due
+    // each rendered frame on a second thread, overlapped with drawing the
+    // frame before; false runs them at the fixed rate on a thread of their own.
+    const bool         PIPELINED    = true;
+    const sf::Time     STEP         = sf::seconds(1.f / 60.f);
+    const unsigned int MAX_SUBSTEPS = 4;
+
+    // GpuExpand uploads one vertex per particle instead of NUM_TRIANGLES * 3
+    const ParticleEmitter::RenderMode RENDER_MODE = ParticleEmitter::RenderMode::GpuExpand;
+
     sf::RenderWindow window(sf::VideoMode(WIDTH, HEIGHT), "Particle Emitter");
     //window.setFramerateLimit(60);
 
     // create the entity
-    ParticleEmitter particle_emitter(NUM_PARTICLES, LIFETIME, RADIUS, NUM_TRIANGLES);
+    ParticleEmitter particle_emitter(NUM_PARTICLES, LIFETIME, RADIUS, NUM_TRIANGLES, RENDER_MODE);
+
+    // update the particles on all cores
+    WorkerPool pool(std::thread::hardware_concurrency());
+    particle_emitter.set_worker_pool(&pool);
 
     sf::Font font;
 
@@ -37,38 +90,16 @@ int main()
     text.setCharacterSize(24);
     text.setFillColor(sf::Color::Red);
 
-    // create a clock to track the elapsed time
-    sf::Clock clock;
-
-    while (window.isOpen())
+    // from here on the emitter belongs to the simulation thread
+    if (PIPELINED)
     {
-        sf::Event event;
-
-        while (window.pollEvent(event))
-        {
-            if (event.type == sf::Event::Closed)
-            {
-                window.close();
-            }
-        }
-
-        // make the partile system follow the mouse
-        sf::Vector2i mouse = sf::Mouse::getPosition(window);
-        particle_emitter.set_emitter(window.mapPixelToCoords(mouse));
-
-        // update it
-        sf::Time elapsed = clock.restart();
-
-        sf::Clock timer;
-        particle_emitter.update(elapsed);
-        sf::Time duration = timer.restart();
-
-        window.clear();
-        window.draw(particle_emitter);
-
-        text.setString(std::to_string(duration.asSeconds()));
-        window.draw(text);
-        window.display();
+        FramePipeline<ParticleEmitter> pipeline(particle_emitter, FixedTimestep(STEP, MAX_SUBSTEPS));
+        run(window, text, pipeline);
+    }
+    else
+    {
+        SimulationThread<ParticleEmitter> simulation(particle_emitter, FixedTimestep(STEP, MAX_SUBSTEPS));
+        run(window, text, simulation);
     }
 
     return 0;
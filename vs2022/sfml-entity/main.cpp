@@ -1,3 +1,4 @@
+#include "FixedTimestep.hpp"
 #include "MyEntity.hpp"
 
 #include <SFML/Graphics.hpp>
@@ -10,6 +11,11 @@
 
 static unsigned int NUM_PARTICLES = 10000;
 
+// the particles advance in steps of this length whatever the frame rate,
+// catching up at most MAX_SUBSTEPS steps at a time after a stall
+static sf::Time     STEP         = sf::seconds(1.f / 60.f);
+static unsigned int MAX_SUBSTEPS = 4;
+
 int main()
 {
     const unsigned int WIDTH  = 1920;
@@ -36,7 +42,8 @@ int main()
     text.setFillColor(sf::Color::Red);
 
     // create a clock to track the elapsed time
-    sf::Clock clock;
+    sf::Clock     clock;
+    FixedTimestep timestep(STEP, MAX_SUBSTEPS);
 
     while (window.isOpen())
     {
@@ -54,11 +61,16 @@ int main()
         sf::Vector2i mouse = sf::Mouse::getPosition(window); 
         my_entity.set_emitter(window.mapPixelToCoords(mouse));
         
-        // update it
-        sf::Time elapsed = clock.restart();
+        // update it by the steps that are due
+        const unsigned int steps = timestep.advance(clock.restart());
 
         sf::Clock timer;
-        my_entity.update(elapsed);
+
+        for (unsigned int step = 0; step < steps; ++step)
+        {
+            my_entity.update(timestep.step());
+        }
+
         sf::Time duration = timer.restart();
 
         window.clear();
@@ -0,0 +1,417 @@
+#include "BarnesHut.hpp"
+
+#include "HostBaseline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+// 21 bits per axis fill 63 bits of the code, deeper cells are leaves
+static const unsigned int MAX_LEVEL = 21;
+
+// spreads the low 21 bits of v so two zero bits follow each of them
+static std::uint64_t spread_bits(std::uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x001f00000000ffffull;
+    v = (v | v << 16) & 0x001f0000ff0000ffull;
+    v = (v | v << 8)  & 0x100f00f00f00f00full;
+    v = (v | v << 4)  & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2)  & 0x1249249249249249ull;
+    return v;
+}
+
+// octant of a code at `level`, the top three bits are level 0
+static unsigned int octant(std::uint64_t code, unsigned int level)
+{
+    return static_cast<unsigned int>(code >> (3 * (MAX_LEVEL - 1 - level))) & 7u;
+}
+
+BarnesHutForces::BarnesHutForces(float theta, std::size_t num_threads, std::size_t leaf_size)
+: m_theta(std::max(theta, 0.f)),
+  m_num_threads(num_threads ? num_threads : host_threads()),
+  m_leaf_size(std::max<std::size_t>(leaf_size, 1)),
+  m_min{0.f, 0.f, 0.f},
+  m_size(0.f),
+  m_interactions(0),
+  m_total_interactions(0)
+{}
+
+std::string BarnesHutForces::name() const
+{
+    std::ostringstream name;
+    name << "barnes-hut " << m_num_threads << " threads, theta " << m_theta;
+
+    return name.str();
+}
+
+void BarnesHutForces::set_theta(float theta)
+{
+    m_theta = std::max(theta, 0.f);
+}
+
+float BarnesHutForces::theta() const
+{
+    return m_theta;
+}
+
+std::size_t BarnesHutForces::num_nodes() const
+{
+    return m_nodes.size();
+}
+
+std::size_t BarnesHutForces::interactions() const
+{
+    return m_interactions;
+}
+
+std::size_t BarnesHutForces::total_interactions() const
+{
+    return m_total_interactions;
+}
+
+void BarnesHutForces::sort_bodies(const Bodies& bodies)
+{
+    const std::size_t n = bodies.size();
+
+    // the bounding cube
+    float low[3]  = { std::numeric_limits<float>::max(),  std::numeric_limits<float>::max(),  std::numeric_limits<float>::max()};
+    float high[3] = {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()};
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        low[0]  = std::min(low[0], bodies.x[i]);
+        low[1]  = std::min(low[1], bodies.y[i]);
+        low[2]  = std::min(low[2], bodies.z[i]);
+        high[0] = std::max(high[0], bodies.x[i]);
+        high[1] = std::max(high[1], bodies.y[i]);
+        high[2] = std::max(high[2], bodies.z[i]);
+    }
+
+    m_size = std::max(std::max(high[0] - low[0], high[1] - low[1]), std::max(high[2] - low[2], 1.e-6f));
+
+    // a little headroom keeps the largest coordinate inside the last cell
+    m_size *= 1.0001f;
+    std::copy(low, low + 3, m_min);
+
+    const float         scale = static_cast<float>(1u << MAX_LEVEL) / m_size;
+    const std::uint64_t top   = (1u << MAX_LEVEL) - 1;
+
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> keys(n);
+
+    parallel_for(n, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const std::uint64_t cx = std::min(static_cast<std::uint64_t>((bodies.x[i] - m_min[0]) * scale), top);
+            const std::uint64_t cy = std::min(static_cast<std::uint64_t>((bodies.y[i] - m_min[1]) * scale), top);
+            const std::uint64_t cz = std::min(static_cast<std::uint64_t>((bodies.z[i] - m_min[2]) * scale), top);
+
+            keys[i].first  = spread_bits(cx) << 2 | spread_bits(cy) << 1 | spread_bits(cz);
+            keys[i].second = static_cast<std::uint32_t>(i);
+        }
+    }, m_num_threads);
+
+    // every thread sorts its chunk, then neighbouring runs are merged pairwise
+    const std::size_t chunk = (n + m_num_threads - 1) / m_num_threads;
+
+    parallel_for(n, [&](std::size_t begin, std::size_t end)
+    {
+        std::sort(keys.begin() + begin, keys.begin() + end);
+    }, m_num_threads);
+
+    for (std::size_t run = chunk; run < n; run *= 2)
+    {
+        const std::size_t num_merges = (n + 2 * run - 1) / (2 * run);
+
+        parallel_for(num_merges, [&](std::size_t first, std::size_t last)
+        {
+            for (std::size_t merge = first; merge < last; ++merge)
+            {
+                const std::size_t begin  = merge * 2 * run;
+                const std::size_t middle = std::min(begin + run, n);
+                const std::size_t end    = std::min(begin + 2 * run, n);
+
+                std::inplace_merge(keys.begin() + begin, keys.begin() + middle, keys.begin() + end);
+            }
+        }, m_num_threads);
+    }
+
+    // the sources in Morton order, so the bodies of a cell are adjacent
+    m_codes.resize(n);
+    m_order.resize(n);
+    m_x.resize(n);
+    m_y.resize(n);
+    m_z.resize(n);
+    m_mass.resize(n);
+
+    parallel_for(n, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const std::uint32_t body = keys[i].second;
+
+            m_codes[i] = keys[i].first;
+            m_order[i] = body;
+            m_x[i]     = bodies.x[body];
+            m_y[i]     = bodies.y[body];
+            m_z[i]     = bodies.z[body];
+            m_mass[i]  = bodies.mass[body];
+        }
+    }, m_num_threads);
+}
+
+void BarnesHutForces::finish_node(std::vector<Node>& nodes, std::uint32_t index) const
+{
+    Node& node = nodes[index];
+
+    double mass = 0.0;
+    double x    = 0.0;
+    double y    = 0.0;
+    double z    = 0.0;
+
+    if (node.next == index + 1)
+    {
+        for (std::uint32_t i = node.first; i < node.first + node.count; ++i)
+        {
+            mass += m_mass[i];
+            x    += static_cast<double>(m_mass[i]) * m_x[i];
+            y    += static_cast<double>(m_mass[i]) * m_y[i];
+            z    += static_cast<double>(m_mass[i]) * m_z[i];
+        }
+    }
+    else
+    {
+        // the first child follows its parent, its siblings follow its subtree
+        for (std::uint32_t child = index + 1; child < node.next; child = nodes[child].next)
+        {
+            mass += nodes[child].mass;
+            x    += static_cast<double>(nodes[child].mass) * nodes[child].x;
+            y    += static_cast<double>(nodes[child].mass) * nodes[child].y;
+            z    += static_cast<double>(nodes[child].mass) * nodes[child].z;
+        }
+    }
+
+    node.mass = static_cast<float>(mass);
+    node.x    = static_cast<float>(mass > 0.0 ? x / mass : 0.0);
+    node.y    = static_cast<float>(mass > 0.0 ? y / mass : 0.0);
+    node.z    = static_cast<float>(mass > 0.0 ? z / mass : 0.0);
+}
+
+void BarnesHutForces::build(std::vector<Node>& nodes, std::uint32_t begin, std::uint32_t end, unsigned int level, float size) const
+{
+    const std::uint32_t index = static_cast<std::uint32_t>(nodes.size());
+
+    Node node;
+    node.size  = size;
+    node.first = begin;
+    node.count = end - begin;
+    nodes.push_back(node);
+
+    if (end - begin > m_leaf_size && level < MAX_LEVEL)
+    {
+        // the sorted range splits into one run per occupied octant
+        for (std::uint32_t child = begin; child < end; )
+        {
+            const unsigned int octant_of_child = octant(m_codes[child], level);
+
+            const std::uint32_t child_end = static_cast<std::uint32_t>(
+                std::partition_point(m_codes.begin() + child, m_codes.begin() + end,
+                                     [&](std::uint64_t code) { return octant(code, level) == octant_of_child; }) - m_codes.begin());
+
+            build(nodes, child, child_end, level + 1, 0.5f * size);
+            child = child_end;
+        }
+    }
+
+    nodes[index].next = static_cast<std::uint32_t>(nodes.size());
+    finish_node(nodes, index);
+}
+
+void BarnesHutForces::build_tree()
+{
+    const std::uint32_t n = static_cast<std::uint32_t>(m_codes.size());
+
+    m_nodes.clear();
+
+    if (n <= m_leaf_size)
+    {
+        build(m_nodes, 0, n, 0, m_size);
+        return;
+    }
+
+    // the ranges of the root's octants
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> octants;
+
+    for (std::uint32_t begin = 0; begin < n; )
+    {
+        const unsigned int root_octant = octant(m_codes[begin], 0);
+
+        std::uint32_t end = begin + 1;
+
+        while (end < n && octant(m_codes[end], 0) == root_octant)
+        {
+            ++end;
+        }
+
+        octants.push_back(std::make_pair(begin, end));
+        begin = end;
+    }
+
+    // every octant builds its subtree into its own array, indices from 0
+    std::vector<std::vector<Node>> subtrees(octants.size());
+
+    parallel_for(octants.size(), [&](std::size_t first, std::size_t last)
+    {
+        for (std::size_t o = first; o < last; ++o)
+        {
+            build(subtrees[o], octants[o].first, octants[o].second, 1, 0.5f * m_size);
+        }
+    }, m_num_threads);
+
+    Node root;
+    root.size  = m_size;
+    root.first = 0;
+    root.count = n;
+    m_nodes.push_back(root);
+
+    for (const std::vector<Node>& subtree : subtrees)
+    {
+        const std::uint32_t offset = static_cast<std::uint32_t>(m_nodes.size());
+
+        for (Node node : subtree)
+        {
+            node.next += offset;
+            m_nodes.push_back(node);
+        }
+    }
+
+    m_nodes[0].next = static_cast<std::uint32_t>(m_nodes.size());
+    finish_node(m_nodes, 0);
+}
+
+void BarnesHutForces::accelerations(Bodies& bodies, const NBodyParams& params)
+{
+    const std::size_t n = bodies.size();
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    sort_bodies(bodies);
+    build_tree();
+
+    const float          eps2   = params.softening * params.softening;
+    const float          theta2 = m_theta * m_theta;
+    const Node*          nodes  = m_nodes.data();
+    const std::uint32_t  count  = static_cast<std::uint32_t>(m_nodes.size());
+
+    std::atomic<std::size_t> interactions(0);
+
+    // targets in Morton order: neighbouring targets open nearly the same
+    // cells, so the nodes they read are still in the cache
+    parallel_for(n, [&](std::size_t begin, std::size_t end)
+    {
+        std::size_t range_interactions = 0;
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const float xi = m_x[i];
+            const float yi = m_y[i];
+            const float zi = m_z[i];
+
+            float sx = 0.f;
+            float sy = 0.f;
+            float sz = 0.f;
+
+            for (std::uint32_t index = 0; index < count; )
+            {
+                const Node& node = nodes[index];
+
+                const float dx = node.x - xi;
+                const float dy = node.y - yi;
+                const float dz = node.z - zi;
+                const float d2 = dx * dx + dy * dy + dz * dz;
+
+                if (node.next == index + 1)
+                {
+                    // leaves are summed body by body, the self term is zero
+                    for (std::uint32_t j = node.first; j < node.first + node.count; ++j)
+                    {
+                        const float bx = m_x[j] - xi;
+                        const float by = m_y[j] - yi;
+                        const float bz = m_z[j] - zi;
+
+                        const float inv_r = 1.f / std::sqrt(bx * bx + by * by + bz * bz + eps2);
+                        const float s     = m_mass[j] * inv_r * inv_r * inv_r;
+
+                        sx += bx * s;
+                        sy += by * s;
+                        sz += bz * s;
+                    }
+
+                    range_interactions += node.count;
+                    index = node.next;
+                }
+                else if (node.size * node.size < theta2 * d2)
+                {
+                    // far enough away to act as one point mass
+                    const float inv_r = 1.f / std::sqrt(d2 + eps2);
+                    const float s     = node.mass * inv_r * inv_r * inv_r;
+
+                    sx += dx * s;
+                    sy += dy * s;
+                    sz += dz * s;
+
+                    range_interactions += 1;
+                    index = node.next;
+                }
+                else
+                {
+                    // open the cell, its first child follows it
+                    index += 1;
+                }
+            }
+
+            const std::uint32_t body = m_order[i];
+
+            bodies.ax[body] = sx * params.G;
+            bodies.ay[body] = sy * params.G;
+            bodies.az[body] = sz * params.G;
+        }
+
+        interactions += range_interactions;
+    }, m_num_threads);
+
+    m_interactions        = interactions;
+    m_total_interactions += m_interactions;
+}
+
+double acceleration_error(const Bodies& exact, const Bodies& approx)
+{
+    const std::size_t n = exact.size();
+
+    double sum = 0.0;
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const double dx = static_cast<double>(approx.ax[i]) - exact.ax[i];
+        const double dy = static_cast<double>(approx.ay[i]) - exact.ay[i];
+        const double dz = static_cast<double>(approx.az[i]) - exact.az[i];
+
+        const double a2 = static_cast<double>(exact.ax[i]) * exact.ax[i] +
+                          static_cast<double>(exact.ay[i]) * exact.ay[i] +
+                          static_cast<double>(exact.az[i]) * exact.az[i];
+
+        if (a2 > 0.0)
+        {
+            sum += (dx * dx + dy * dy + dz * dz) / a2;
+        }
+    }
+
+    return n > 0 ? std::sqrt(sum / n) : 0.0;
+}
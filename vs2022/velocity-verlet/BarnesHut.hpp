@@ -0,0 +1,78 @@
+#pragma once
+
+#include "NBody.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Barnes-Hut approximation of the softened direct sum in O(N log N).
+//
+// every call sorts the bodies along a Morton curve and builds an octree
+// over the sorted order: a cell owns a contiguous range of bodies, so the
+// tree is a flat array in depth-first order without pointers. a node with
+// children is followed by its first child and `next` is the node after its
+// subtree, so the traversal is a single loop that either descends to n + 1
+// or skips to next. the eight subtrees under the root are built in parallel.
+//
+// a cell of edge s whose centre of mass is at distance d from the target is
+// taken as one point mass when s < theta * d. theta 0 opens every cell and
+// only the leaves are summed, which reproduces the exact sum.
+class BarnesHutForces : public ForceSolver
+{
+public:
+    // 0 threads uses every hardware thread; a leaf holds up to leaf_size bodies
+    explicit BarnesHutForces(float theta = 0.5f, std::size_t num_threads = 0, std::size_t leaf_size = 8);
+
+    virtual std::string name() const;
+
+    virtual void accelerations(Bodies& bodies, const NBodyParams& params);
+
+    void  set_theta(float theta);
+    float theta() const;
+
+    // of the last accelerations() call
+    std::size_t num_nodes() const;
+    std::size_t interactions() const;
+
+    // summed over every accelerations() call so far
+    std::size_t total_interactions() const;
+
+private:
+    struct Node
+    {
+        float         x, y, z, mass; // centre of mass
+        float         size;          // edge of the cell
+        std::uint32_t next;          // the node after this subtree, n + 1 for a leaf
+        std::uint32_t first;         // bodies [first, first + count) of the sorted order
+        std::uint32_t count;
+    };
+
+    void sort_bodies(const Bodies& bodies);
+    void build_tree();
+
+    // appends the subtree of sorted bodies [begin, end) at `level` to `nodes`
+    void build(std::vector<Node>& nodes, std::uint32_t begin, std::uint32_t end, unsigned int level, float size) const;
+
+    // the node of a leaf or the children of an inner node are already set
+    void finish_node(std::vector<Node>& nodes, std::uint32_t index) const;
+
+    float       m_theta;
+    std::size_t m_num_threads;
+    std::size_t m_leaf_size;
+
+    // the bounding cube of the last sort
+    float m_min[3];
+    float m_size;
+
+    std::vector<std::uint64_t> m_codes;  // sorted Morton codes
+    std::vector<std::uint32_t> m_order;  // sorted position -> body index
+    std::vector<float>         m_x, m_y, m_z, m_mass;
+    std::vector<Node>          m_nodes;
+    std::size_t                m_interactions;
+    std::size_t                m_total_interactions;
+};
+
+// root mean square of |a - a_exact| / |a_exact| over the bodies
+double acceleration_error(const Bodies& exact, const Bodies& approx);
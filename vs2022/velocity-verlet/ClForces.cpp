@@ -0,0 +1,93 @@
+#include "ClForces.hpp"
+
+#include <algorithm>
+
+ClForces::ClForces(ClRuntime& runtime, const std::string& kernel_file, bool fast_math, std::size_t local_size)
+: m_runtime(runtime),
+  m_fast_math(fast_math),
+  m_local_size(local_size),
+  m_kernel_seconds(0.0),
+  m_transfer_seconds(0.0)
+{
+    m_kernel = runtime.kernel(kernel_file, "accelerations",
+                              fast_math ? "-cl-std=CL1.2 -D FAST_MATH -cl-fast-relaxed-math" : "-cl-std=CL1.2");
+
+    // the tile is one source per work-item, so the kernel limit bounds it as well
+    const std::size_t limit = m_kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(runtime.device());
+
+    while (m_local_size > limit && m_local_size > 1)
+    {
+        m_local_size /= 2;
+    }
+}
+
+std::string ClForces::name() const
+{
+    return "opencl " + std::string(m_fast_math ? "fast math" : "precise") + ", local " + std::to_string(m_local_size);
+}
+
+void ClForces::resize(std::size_t count)
+{
+    if (m_packed.size() == count)
+    {
+        return;
+    }
+
+    m_packed        = HostArray<cl_float4>(count);
+    m_accelerations = HostArray<cl_float4>(count);
+    m_bodies_buffer = DeviceBuffer<cl_float4>(m_runtime.context(), count, CL_MEM_READ_ONLY);
+    m_accel_buffer  = DeviceBuffer<cl_float4>(m_runtime.context(), count, CL_MEM_WRITE_ONLY);
+}
+
+void ClForces::accelerations(Bodies& bodies, const NBodyParams& params)
+{
+    const std::size_t n = bodies.size();
+
+    resize(n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        m_packed[i] = {{bodies.x[i], bodies.y[i], bodies.z[i], bodies.mass[i]}};
+    }
+
+    cl::CommandQueue& queue = m_runtime.queue();
+
+    cl::Event upload;
+    cl::Event kernel;
+    cl::Event download;
+
+    queue.enqueueWriteBuffer(m_bodies_buffer.get(), CL_FALSE, 0, m_bodies_buffer.bytes(), m_packed.data(), NULL, &upload);
+
+    m_kernel.setArg(0, m_bodies_buffer.get());
+    m_kernel.setArg(1, m_accel_buffer.get());
+    m_kernel.setArg(2, static_cast<cl_uint>(n));
+    m_kernel.setArg(3, params.softening * params.softening);
+    m_kernel.setArg(4, params.G);
+    m_kernel.setArg(5, cl::Local(m_local_size * sizeof(cl_float4)));
+
+    // whole work-groups, the padding bodies have no mass and write nothing
+    const std::size_t global_size = (n + m_local_size - 1) / m_local_size * m_local_size;
+
+    queue.enqueueNDRangeKernel(m_kernel, cl::NullRange, cl::NDRange(global_size), cl::NDRange(m_local_size), NULL, &kernel);
+    queue.enqueueReadBuffer(m_accel_buffer.get(), CL_TRUE, 0, m_accel_buffer.bytes(), m_accelerations.data(), NULL, &download);
+
+    m_kernel_seconds   += elapsed_seconds(kernel);
+    m_transfer_seconds += elapsed_seconds(upload) + elapsed_seconds(download);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        bodies.ax[i] = m_accelerations[i].s[0];
+        bodies.ay[i] = m_accelerations[i].s[1];
+        bodies.az[i] = m_accelerations[i].s[2];
+    }
+}
+
+double ClForces::kernel_seconds() const
+{
+    return m_kernel_seconds;
+}
+
+double ClForces::transfer_seconds() const
+{
+    return m_transfer_seconds;
+}
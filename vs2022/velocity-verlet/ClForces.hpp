@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ClRuntime.hpp"
+#include "NBody.hpp"
+
+#include <string>
+
+// OpenCL backend of the direct sum: the positions and masses are packed
+// into float4 (x, y, z, mass) and uploaded every call, every work-item
+// sums the forces on one body while its work-group stages the sources
+// through local memory one tile at a time, and the accelerations are read
+// back into the SoA arrays. fast math trades the correctly rounded rsqrt
+// for native_rsqrt and -cl-fast-relaxed-math.
+class ClForces : public ForceSolver
+{
+public:
+    ClForces(ClRuntime& runtime,
+             const std::string& kernel_file = "nbody.cl",
+             bool fast_math = false,
+             std::size_t local_size = 256);
+
+    virtual std::string name() const;
+
+    virtual void accelerations(Bodies& bodies, const NBodyParams& params);
+
+    // device time of all accelerations() calls so far, kernels and transfers
+    double kernel_seconds() const;
+    double transfer_seconds() const;
+
+private:
+    void resize(std::size_t count);
+
+    ClRuntime&              m_runtime;
+    cl::Kernel              m_kernel;
+    bool                    m_fast_math;
+    std::size_t             m_local_size;
+    HostArray<cl_float4>    m_packed;
+    HostArray<cl_float4>    m_accelerations;
+    DeviceBuffer<cl_float4> m_bodies_buffer;
+    DeviceBuffer<cl_float4> m_accel_buffer;
+    double                  m_kernel_seconds;
+    double                  m_transfer_seconds;
+};
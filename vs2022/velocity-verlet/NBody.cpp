@@ -0,0 +1,224 @@
+#include "NBody.hpp"
+
+#include "HostBaseline.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <random>
+
+CpuForces::CpuForces(std::size_t num_threads, std::size_t block_size)
+: m_num_threads(num_threads ? num_threads : host_threads()),
+  m_block_size(std::max<std::size_t>(block_size, 1))
+{}
+
+std::string CpuForces::name() const
+{
+    return "cpu " + std::to_string(m_num_threads) + " threads, block " + std::to_string(m_block_size);
+}
+
+void CpuForces::accelerations(Bodies& bodies, const NBodyParams& params)
+{
+    const std::size_t n     = bodies.size();
+    const float       eps2  = params.softening * params.softening;
+    const std::size_t block = m_block_size;
+
+    const float* x    = bodies.x.data();
+    const float* y    = bodies.y.data();
+    const float* z    = bodies.z.data();
+    const float* mass = bodies.mass.data();
+
+    float* ax = bodies.ax.data();
+    float* ay = bodies.ay.data();
+    float* az = bodies.az.data();
+
+    parallel_for(n, [&](std::size_t begin, std::size_t end)
+    {
+        std::fill(ax + begin, ax + end, 0.f);
+        std::fill(ay + begin, ay + end, 0.f);
+        std::fill(az + begin, az + end, 0.f);
+
+        // one block of sources against every target of the range
+        for (std::size_t first = 0; first < n; first += block)
+        {
+            const std::size_t last = std::min(first + block, n);
+
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                const float xi = x[i];
+                const float yi = y[i];
+                const float zi = z[i];
+
+                float sx = 0.f;
+                float sy = 0.f;
+                float sz = 0.f;
+
+                for (std::size_t j = first; j < last; ++j)
+                {
+                    const float dx = x[j] - xi;
+                    const float dy = y[j] - yi;
+                    const float dz = z[j] - zi;
+
+                    const float inv_r = 1.f / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+                    const float s     = mass[j] * inv_r * inv_r * inv_r;
+
+                    sx += dx * s;
+                    sy += dy * s;
+                    sz += dz * s;
+                }
+
+                ax[i] += sx;
+                ay[i] += sy;
+                az[i] += sz;
+            }
+        }
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            ax[i] *= params.G;
+            ay[i] *= params.G;
+            az[i] *= params.G;
+        }
+    }, m_num_threads);
+}
+
+// half kick and drift of bodies [begin, end)
+static void kick_drift(Bodies& bodies, std::size_t begin, std::size_t end, float dt)
+{
+    const float half_dt = 0.5f * dt;
+
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        bodies.vx[i] += bodies.ax[i] * half_dt;
+        bodies.vy[i] += bodies.ay[i] * half_dt;
+        bodies.vz[i] += bodies.az[i] * half_dt;
+
+        bodies.x[i] += bodies.vx[i] * dt;
+        bodies.y[i] += bodies.vy[i] * dt;
+        bodies.z[i] += bodies.vz[i] * dt;
+    }
+}
+
+static void kick(Bodies& bodies, std::size_t begin, std::size_t end, float dt)
+{
+    const float half_dt = 0.5f * dt;
+
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        bodies.vx[i] += bodies.ax[i] * half_dt;
+        bodies.vy[i] += bodies.ay[i] * half_dt;
+        bodies.vz[i] += bodies.az[i] * half_dt;
+    }
+}
+
+void velocity_verlet_step(Bodies& bodies, ForceSolver& solver, const NBodyParams& params)
+{
+    parallel_for(bodies.size(), [&](std::size_t begin, std::size_t end)
+    {
+        kick_drift(bodies, begin, end, params.dt);
+    });
+
+    solver.accelerations(bodies, params);
+
+    parallel_for(bodies.size(), [&](std::size_t begin, std::size_t end)
+    {
+        kick(bodies, begin, end, params.dt);
+    });
+}
+
+double total_energy(const Bodies& bodies, const NBodyParams& params)
+{
+    const std::size_t n    = bodies.size();
+    const double      eps2 = static_cast<double>(params.softening) * params.softening;
+
+    std::mutex mutex;
+    double     kinetic   = 0.0;
+    double     potential = 0.0;
+
+    // every pair is visited from both sides, which keeps the ranges balanced
+    parallel_for(n, [&](std::size_t begin, std::size_t end)
+    {
+        double range_kinetic   = 0.0;
+        double range_potential = 0.0;
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            const double v2 = static_cast<double>(bodies.vx[i]) * bodies.vx[i] +
+                              static_cast<double>(bodies.vy[i]) * bodies.vy[i] +
+                              static_cast<double>(bodies.vz[i]) * bodies.vz[i];
+
+            range_kinetic += 0.5 * bodies.mass[i] * v2;
+
+            for (std::size_t j = 0; j < n; ++j)
+            {
+                if (j == i)
+                {
+                    continue;
+                }
+
+                const double dx = static_cast<double>(bodies.x[j]) - bodies.x[i];
+                const double dy = static_cast<double>(bodies.y[j]) - bodies.y[i];
+                const double dz = static_cast<double>(bodies.z[j]) - bodies.z[i];
+
+                range_potential -= static_cast<double>(bodies.mass[i]) * bodies.mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        kinetic   += range_kinetic;
+        potential += range_potential;
+    });
+
+    return kinetic + 0.5 * params.G * potential;
+}
+
+void init_sphere(Bodies& bodies, unsigned int seed)
+{
+    const std::size_t n = bodies.size();
+
+    std::mt19937                          generator(seed);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+    std::normal_distribution<float>       dispersion(0.f, 0.05f);
+
+    double mean[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        float px, py, pz;
+
+        // rejection sampling keeps the points uniform inside the sphere
+        do
+        {
+            px = uniform(generator);
+            py = uniform(generator);
+            pz = uniform(generator);
+        }
+        while (px * px + py * py + pz * pz > 1.f);
+
+        bodies.x[i]    = px;
+        bodies.y[i]    = py;
+        bodies.z[i]    = pz;
+        bodies.vx[i]   = dispersion(generator);
+        bodies.vy[i]   = dispersion(generator);
+        bodies.vz[i]   = dispersion(generator);
+        bodies.mass[i] = 1.f / static_cast<float>(n);
+
+        mean[0] += px;
+        mean[1] += py;
+        mean[2] += pz;
+        mean[3] += bodies.vx[i];
+        mean[4] += bodies.vy[i];
+        mean[5] += bodies.vz[i];
+    }
+
+    // equal masses, so the centre of mass and the mean velocity are plain means
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        bodies.x[i]  -= static_cast<float>(mean[0] / n);
+        bodies.y[i]  -= static_cast<float>(mean[1] / n);
+        bodies.z[i]  -= static_cast<float>(mean[2] / n);
+        bodies.vx[i] -= static_cast<float>(mean[3] / n);
+        bodies.vy[i] -= static_cast<float>(mean[4] / n);
+        bodies.vz[i] -= static_cast<float>(mean[5] / n);
+    }
+}
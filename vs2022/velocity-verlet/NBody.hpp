@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// structure-of-arrays state of the bodies: every component lives in its own
+// contiguous array so the force loops stream through memory linearly
+struct Bodies
+{
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> ax, ay, az; // acceleration at the current positions
+    std::vector<float> mass;
+
+    explicit Bodies(std::size_t count = 0)
+    {
+        resize(count);
+    }
+
+    void resize(std::size_t count)
+    {
+        for (std::vector<float>* component : {&x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass})
+        {
+            component->assign(count, 0.f);
+        }
+    }
+
+    std::size_t size() const
+    {
+        return mass.size();
+    }
+};
+
+// gravity between softened point masses (Plummer): the force of j on i is
+//   G m_i m_j (r_j - r_i) / (|r_j - r_i|^2 + softening^2)^(3/2)
+// the softening keeps close encounters finite and makes the self term zero
+struct NBodyParams
+{
+    float G         = 1.f;
+    float softening = 0.05f;
+    float dt        = 1.e-3f;
+};
+
+// where the accelerations are computed. one call fills ax, ay and az of
+// every body from the current positions and masses.
+class ForceSolver
+{
+public:
+    virtual ~ForceSolver() {}
+
+    virtual std::string name() const = 0;
+
+    virtual void accelerations(Bodies& bodies, const NBodyParams& params) = 0;
+};
+
+// direct O(N^2) sum on the CPU. every thread owns a range of target bodies
+// and walks the sources in blocks small enough to stay in the L1 cache
+// while the whole target range passes over them.
+class CpuForces : public ForceSolver
+{
+public:
+    // 0 threads uses every hardware thread
+    explicit CpuForces(std::size_t num_threads = 0, std::size_t block_size = 1024);
+
+    virtual std::string name() const;
+
+    virtual void accelerations(Bodies& bodies, const NBodyParams& params);
+
+private:
+    std::size_t m_num_threads;
+    std::size_t m_block_size;
+};
+
+// one velocity-Verlet step: half kick with the old accelerations, drift,
+// new accelerations, half kick with the new ones. the accelerations have to
+// match the positions before the first step.
+void velocity_verlet_step(Bodies& bodies, ForceSolver& solver, const NBodyParams& params);
+
+// kinetic plus potential energy, summed in double precision
+double total_energy(const Bodies& bodies, const NBodyParams& params);
+
+// a cold uniform sphere of unit radius and unit total mass with a small
+// random velocity dispersion and no net momentum
+void init_sphere(Bodies& bodies, unsigned int seed);
@@ -1,10 +1,330 @@
-#define CL_HPP_ENABLE_EXCEPTIONS
-#define CL_TARGET_OPENCL_VERSION 220
-#define CL_HPP_TARGET_OPENCL_VERSION 220
+#include "BarnesHut.hpp"
+#include "ClForces.hpp"
+#include "ClRuntime.hpp"
+#include "HostBaseline.hpp"
+#include "NBody.hpp"
 
-#include <CL/opencl.hpp>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
-int main()
+// velocity-Verlet N-body benchmark: every force backend advances the same
+// cold sphere for the same number of steps and reports its throughput in
+// body-body interactions per second next to the relative energy drift,
+// the accuracy the step size, the backend and its math mode leave.
+// the Barnes-Hut rows count the body-body and body-cell interactions the
+// tree actually evaluated, compare their ms/step with the exact solvers.
+
+// flops of one interaction, the usual convention for the softened direct sum
+static const double FLOPS_PER_INTERACTION = 20.0;
+
+struct RunConfig
+{
+    std::size_t  bodies  = 4096;
+    unsigned int steps   = 100;
+    std::size_t  threads = 0;    // every hardware thread
+    std::size_t  block   = 1024; // sources per cache block of the CPU solver
+    unsigned int seed    = 1;
+    bool         opencl  = true;
+    bool         sweep   = false;
+    bool         exact   = true;  // the direct sums, on the CPU and OpenCL
+    bool         tree    = true;  // the Barnes-Hut approximation
+    float        theta   = 0.5f;  // opening angle of the tree
+    std::size_t  leaf    = 8;     // bodies per leaf of the tree
+    NBodyParams  params;
+};
+
+struct RunResult
+{
+    double seconds;
+    double drift;
+    double interactions; // evaluated during the timed steps
+};
+
+static void usage(const char* program)
+{
+    std::cerr << "usage: " << program << " [--bodies N] [--steps N] [--dt SECONDS] [--softening EPS]"
+              << " [--threads N] [--block N] [--seed N] [--sweep] [--no-opencl] [--cpu|--gpu|--device NAME]"
+              << " [--solver exact|barnes-hut|all] [--theta X] [--leaf N]" << std::endl;
+}
+
+static bool parse_args(int argc, char* argv[], RunConfig& config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool has_value = i + 1 < argc;
+
+        if (std::strcmp(argv[i], "--bodies") == 0 && has_value)
+        {
+            config.bodies = static_cast<std::size_t>(std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--steps") == 0 && has_value)
+        {
+            config.steps = static_cast<unsigned int>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--dt") == 0 && has_value)
+        {
+            config.params.dt = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--softening") == 0 && has_value)
+        {
+            config.params.softening = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+        {
+            config.threads = static_cast<std::size_t>(std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--block") == 0 && has_value)
+        {
+            config.block = static_cast<std::size_t>(std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && has_value)
+        {
+            config.seed = static_cast<unsigned int>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--solver") == 0 && has_value)
+        {
+            const std::string solver = argv[++i];
+
+            config.exact = solver == "exact" || solver == "all";
+            config.tree  = solver == "barnes-hut" || solver == "all";
+
+            if (!config.exact && !config.tree)
+            {
+                return false;
+            }
+        }
+        else if (std::strcmp(argv[i], "--theta") == 0 && has_value)
+        {
+            config.theta = static_cast<float>(std::atof(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--leaf") == 0 && has_value)
+        {
+            config.leaf = static_cast<std::size_t>(std::atol(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--sweep") == 0)
+        {
+            config.sweep = true;
+        }
+        else if (std::strcmp(argv[i], "--no-opencl") == 0)
+        {
+            config.opencl = false;
+        }
+        else if (std::strcmp(argv[i], "--device") == 0 && has_value)
+        {
+            ++i; // read by DeviceQuery::from_args
+        }
+        else if (std::strcmp(argv[i], "--cpu") != 0 && std::strcmp(argv[i], "--gpu") != 0)
+        {
+            return false;
+        }
+    }
+
+    // a zero softening would make the self term of the direct sum infinite
+    return config.bodies > 0 && config.steps > 0 && config.params.softening > 0.f && config.theta >= 0.f && config.leaf > 0;
+}
+
+// advances a copy of `initial` by `steps` steps of `params.dt`
+static RunResult run(const Bodies& initial, ForceSolver& solver, const NBodyParams& params, unsigned int steps)
+{
+    Bodies bodies = initial;
+
+    solver.accelerations(bodies, params);
+
+    const double start_energy = total_energy(bodies, params);
+
+    // the direct sum evaluates every pair, a tree counts what it evaluated
+    const BarnesHutForces* tree       = dynamic_cast<const BarnesHutForces*>(&solver);
+    const std::size_t      tree_start = tree != nullptr ? tree->total_interactions() : 0;
+
+    HostTimer timer;
+
+    for (unsigned int step = 0; step < steps; ++step)
+    {
+        velocity_verlet_step(bodies, solver, params);
+    }
+
+    RunResult result;
+    result.seconds      = timer.seconds();
+    result.drift        = std::fabs((total_energy(bodies, params) - start_energy) / start_energy);
+    result.interactions = tree != nullptr ? static_cast<double>(tree->total_interactions() - tree_start)
+                                          : static_cast<double>(bodies.size()) * bodies.size() * steps;
+
+    return result;
+}
+
+static void print_header()
+{
+    std::cout << std::left << std::setw(40) << "solver" << std::right
+              << std::setw(10) << "dt"
+              << std::setw(12) << "ms/step"
+              << std::setw(18) << "interactions/s"
+              << std::setw(12) << "GFLOP/s"
+              << std::setw(16) << "energy drift" << std::endl;
+}
+
+static void print_row(const std::string& name, const NBodyParams& params, unsigned int steps, const RunResult& result)
+{
+    const double interactions = result.interactions;
+
+    std::cout << std::left << std::setw(40) << name << std::right
+              << std::setw(10) << params.dt
+              << std::fixed << std::setprecision(3)
+              << std::setw(12) << result.seconds / steps * 1.0e3
+              << std::scientific << std::setprecision(3)
+              << std::setw(18) << interactions / result.seconds
+              << std::fixed << std::setprecision(2)
+              << std::setw(12) << interactions * FLOPS_PER_INTERACTION / result.seconds * 1.0e-9
+              << std::scientific << std::setprecision(3)
+              << std::setw(16) << result.drift << std::endl;
+
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+int main(int argc, char* argv[])
 {
-	return 0;
-}
\ No newline at end of file
+    RunConfig config;
+
+    if (!parse_args(argc, argv, config))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Bodies initial(config.bodies);
+    init_sphere(initial, config.seed);
+
+    std::cout << "# bodies: " << config.bodies << ", steps: " << config.steps
+              << ", softening: " << config.params.softening << std::endl;
+
+    std::vector<std::unique_ptr<ForceSolver>> solvers;
+
+    if (config.exact)
+    {
+        solvers.emplace_back(new CpuForces(config.threads, config.block));
+    }
+
+    if (config.tree)
+    {
+        solvers.emplace_back(new BarnesHutForces(config.theta, config.threads, config.leaf));
+    }
+
+    std::unique_ptr<ClRuntime> runtime;
+
+    if (config.opencl && config.exact)
+    {
+        try
+        {
+            runtime.reset(new ClRuntime(DeviceQuery::from_args(argc, argv)));
+            std::cout << "OpenCL device: " << runtime->device_name() << std::endl;
+
+            solvers.emplace_back(new ClForces(*runtime, "nbody.cl", false));
+            solvers.emplace_back(new ClForces(*runtime, "nbody.cl", true));
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "OpenCL not available, running on the CPU only: " << e.what() << std::endl;
+        }
+    }
+
+    std::cout << std::endl;
+    print_header();
+
+    try
+    {
+        std::size_t fastest      = 0;
+        double      fastest_time = 0.0;
+
+        for (std::size_t s = 0; s < solvers.size(); ++s)
+        {
+            const RunResult result = run(initial, *solvers[s], config.params, config.steps);
+            print_row(solvers[s]->name(), config.params, config.steps, result);
+
+            if (s == 0 || result.seconds < fastest_time)
+            {
+                fastest      = s;
+                fastest_time = result.seconds;
+            }
+
+            if (ClForces* cl_forces = dynamic_cast<ClForces*>(solvers[s].get()))
+            {
+                const double interactions = static_cast<double>(config.bodies) * config.bodies * (config.steps + 1);
+
+                std::cout << "    device: kernel " << cl_forces->kernel_seconds() * 1.0e3 << " ms ("
+                          << interactions / cl_forces->kernel_seconds() << " interactions/s), transfers "
+                          << cl_forces->transfer_seconds() * 1.0e3 << " ms" << std::endl;
+            }
+
+            if (BarnesHutForces* tree = dynamic_cast<BarnesHutForces*>(solvers[s].get()))
+            {
+                std::cout << "    tree: " << tree->num_nodes() << " nodes, "
+                          << static_cast<double>(tree->interactions()) / config.bodies << " interactions per body" << std::endl;
+            }
+        }
+
+        // the approximation against the exact sum at the initial positions
+        if (config.exact && config.tree)
+        {
+            Bodies exact = initial;
+            Bodies approx = initial;
+
+            CpuForces(config.threads, config.block).accelerations(exact, config.params);
+
+            std::cout << std::endl
+                      << std::left << std::setw(16) << "theta" << std::right
+                      << std::setw(16) << "nodes"
+                      << std::setw(24) << "interactions/body"
+                      << std::setw(16) << "rms error" << std::endl;
+
+            for (float theta : {0.f, 0.25f, 0.5f, 0.75f, 1.f})
+            {
+                BarnesHutForces tree(theta, config.threads, config.leaf);
+                tree.accelerations(approx, config.params);
+
+                std::cout << std::left << std::setw(16) << theta << std::right
+                          << std::setw(16) << tree.num_nodes()
+                          << std::setw(24) << static_cast<double>(tree.interactions()) / config.bodies
+                          << std::setw(16) << acceleration_error(exact, approx) << std::endl;
+            }
+        }
+
+        // the same simulated time with ever larger steps: fewer force
+        // evaluations for a larger drift
+        if (config.sweep)
+        {
+            std::cout << std::endl;
+            print_header();
+
+            for (unsigned int scale = 1; scale <= 8 && config.steps / scale > 0; scale *= 2)
+            {
+                NBodyParams params = config.params;
+                params.dt *= scale;
+
+                const unsigned int steps = config.steps / scale;
+
+                print_row(solvers[fastest]->name(), params, steps, run(initial, *solvers[fastest], params, steps));
+            }
+        }
+    }
+    catch (cl::Error& e)
+    {
+        std::cerr << "OpenCL error: " << e.what() << " (" << e.err() << ")" << std::endl;
+        return EXIT_FAILURE;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the solvers hold buffers of the runtime
+    solvers.clear();
+
+    return 0;
+}
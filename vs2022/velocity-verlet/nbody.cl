@@ -0,0 +1,53 @@
+// FAST_MATH swaps the correctly rounded rsqrt for the native one
+#ifdef FAST_MATH
+#define RSQRT native_rsqrt
+#else
+#define RSQRT rsqrt
+#endif
+
+// softened gravitational acceleration of one body per work-item. a body is
+// (x, y, z, mass); the work-group loads the sources into local memory one
+// tile of its own size at a time, so each source is read from global
+// memory once per work-group instead of once per work-item. the softening
+// makes the self term zero and padding sources have no mass.
+__kernel void accelerations(__global const float4* bodies,
+                            __global float4* accel,
+                            const uint count,
+                            const float softening2,
+                            const float g,
+                            __local float4* tile)
+{
+    const uint i    = get_global_id(0);
+    const uint lid  = get_local_id(0);
+    const uint size = get_local_size(0);
+
+    const float3 pi = i < count ? bodies[i].xyz : (float3)(0.0f);
+
+    float3 acc = (float3)(0.0f);
+
+    for (uint base = 0; base < count; base += size)
+    {
+        const uint j = base + lid;
+
+        tile[lid] = j < count ? bodies[j] : (float4)(0.0f);
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (uint k = 0; k < size; ++k)
+        {
+            const float4 pj = tile[k];
+            const float3 d  = pj.xyz - pi;
+
+            const float inv_r = RSQRT(dot(d, d) + softening2);
+
+            acc += d * (pj.w * inv_r * inv_r * inv_r);
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (i < count)
+    {
+        accel[i] = (float4)(acc * g, 0.0f);
+    }
+}